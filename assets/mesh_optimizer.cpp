@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <utils/util.h>
+
+#include "mesh_optimizer.h"
+
+namespace assets
+{
+
+struct vertex_hash
+{
+	size_t operator()(const vertex &vertex) const
+	{
+		/* FNV-1a, vertex is tightly packed floats so hashing the bytes is fine. */
+		const u8 *bytes = reinterpret_cast<const u8 *>(&vertex);
+		u64 hash = 14695981039346656037ull;
+		for (size_t i = 0; i < sizeof(vertex); ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+};
+
+struct vertex_equal
+{
+	bool operator()(const vertex &a, const vertex &b) const
+	{
+		return memcmp(&a, &b, sizeof(vertex)) == 0;
+	}
+};
+
+float analyze_vertex_cache(const std::vector<u32> &indices, u32 vertex_count, u32 cache_size)
+{
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+	{
+		return 0.0f;
+	}
+
+	/* A vertex is in the cache if fewer than cache_size misses happened since it was last loaded. */
+	std::vector<u32> timestamps(vertex_count, 0);
+	u32 time = cache_size + 1;
+	u32 misses = 0;
+	for (u32 index : indices)
+	{
+		if (time - timestamps[index] > cache_size)
+		{
+			timestamps[index] = time++;
+			++misses;
+		}
+	}
+
+	return (float)misses / (float)triangle_count;
+}
+
+u32 weld_vertices(std::vector<vertex> &vertices, std::vector<u32> &indices)
+{
+	std::unordered_map<vertex, u32, vertex_hash, vertex_equal> unique_vertices = {};
+	unique_vertices.reserve(vertices.size());
+
+	std::vector<u32> remap(vertices.size());
+	std::vector<vertex> welded_vertices = {};
+	welded_vertices.reserve(vertices.size());
+	for (size_t v_idx = 0; v_idx < vertices.size(); ++v_idx)
+	{
+		auto [it, inserted] = unique_vertices.try_emplace(vertices[v_idx], (u32)welded_vertices.size());
+		if (inserted)
+		{
+			welded_vertices.push_back(vertices[v_idx]);
+		}
+		remap[v_idx] = it->second;
+	}
+
+	for (u32 &index : indices)
+	{
+		index = remap[index];
+	}
+	vertices = std::move(welded_vertices);
+
+	return vertices.size();
+}
+
+/* Tom Forsyth's linear-speed vertex cache optimization, modelling an LRU cache. */
+static constexpr u32 forsyth_cache_size = 32;
+
+static float forsyth_vertex_score(i32 cache_position, u32 live_triangles)
+{
+	if (live_triangles == 0)
+	{
+		/* No triangles left to emit, the vertex is irrelevant. */
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cache_position >= 0)
+	{
+		if (cache_position < 3)
+		{
+			/* Used by the last triangle, fixed score to avoid favouring one of its vertices. */
+			score = 0.75f;
+		}
+		else
+		{
+			const float scale = 1.0f / (float)(forsyth_cache_size - 3);
+			score = std::pow(1.0f - (float)(cache_position - 3) * scale, 1.5f);
+		}
+	}
+
+	/* Boost vertices with few triangles left, to finish them off and avoid leaving lone triangles. */
+	score += 2.0f * std::pow((float)live_triangles, -0.5f);
+	return score;
+}
+
+void optimize_vertex_cache(std::vector<u32> &indices, u32 vertex_count)
+{
+	const u32 triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	/* Vertex to triangle adjacency, the live triangles of vertex v are the first live_triangles[v] entries. */
+	std::vector<u32> live_triangles(vertex_count, 0);
+	for (u32 index : indices)
+	{
+		++live_triangles[index];
+	}
+	std::vector<u32> adjacency_offsets(vertex_count + 1, 0);
+	for (u32 v = 0; v < vertex_count; ++v)
+	{
+		adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+	}
+	std::vector<u32> adjacency(indices.size());
+	{
+		std::vector<u32> cursors(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (u32 t = 0; t < triangle_count; ++t)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				adjacency[cursors[indices[3 * t + k]]++] = t;
+			}
+		}
+	}
+
+	/* Initial scores. */
+	std::vector<i32> cache_positions(vertex_count, -1);
+	std::vector<float> vertex_scores(vertex_count);
+	for (u32 v = 0; v < vertex_count; ++v)
+	{
+		vertex_scores[v] = forsyth_vertex_score(-1, live_triangles[v]);
+	}
+	std::vector<float> triangle_scores(triangle_count);
+	i64 best_triangle = -1;
+	float best_score = -1.0f;
+	for (u32 t = 0; t < triangle_count; ++t)
+	{
+		triangle_scores[t] = vertex_scores[indices[3 * t + 0]] + vertex_scores[indices[3 * t + 1]] +
+		                     vertex_scores[indices[3 * t + 2]];
+		if (triangle_scores[t] > best_score)
+		{
+			best_score = triangle_scores[t];
+			best_triangle = t;
+		}
+	}
+
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<u32> cache = {};
+	std::vector<u32> new_cache = {};
+	std::vector<u32> result = {};
+	result.reserve(indices.size());
+	u32 scan_cursor = 0;
+	while (result.size() < indices.size())
+	{
+		if (best_triangle < 0)
+		{
+			/* Nothing in the cache has live triangles, continue with the next triangle in input order. */
+			while (emitted[scan_cursor])
+			{
+				++scan_cursor;
+			}
+			best_triangle = scan_cursor;
+		}
+
+		/* Emit the triangle and remove it from the adjacency of its vertices. */
+		const u32 t = (u32)best_triangle;
+		emitted[t] = true;
+		new_cache.clear();
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const u32 v = indices[3 * t + k];
+			result.push_back(v);
+
+			u32 *triangles = &adjacency[adjacency_offsets[v]];
+			u32 *it = std::find(triangles, triangles + live_triangles[v], t);
+			std::swap(*it, triangles[live_triangles[v] - 1]);
+			--live_triangles[v];
+
+			if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+			{
+				new_cache.push_back(v);
+			}
+		}
+
+		/* Move the triangle's vertices to the front of the cache. */
+		const size_t triangle_vertex_count = new_cache.size();
+		for (u32 v : cache)
+		{
+			if (std::find(new_cache.begin(), new_cache.begin() + triangle_vertex_count, v) ==
+			    new_cache.begin() + triangle_vertex_count)
+			{
+				new_cache.push_back(v);
+			}
+		}
+		for (size_t c = 0; c < new_cache.size(); ++c)
+		{
+			const u32 v = new_cache[c];
+			cache_positions[v] = c < forsyth_cache_size ? (i32)c : -1;
+			vertex_scores[v] = forsyth_vertex_score(cache_positions[v], live_triangles[v]);
+		}
+
+		/* Rescore triangles touched by the cache and pick the best one among them. */
+		best_triangle = -1;
+		best_score = -1.0f;
+		for (u32 v : new_cache)
+		{
+			const u32 *triangles = &adjacency[adjacency_offsets[v]];
+			for (u32 a = 0; a < live_triangles[v]; ++a)
+			{
+				const u32 adjacent = triangles[a];
+				triangle_scores[adjacent] = vertex_scores[indices[3 * adjacent + 0]] +
+				                            vertex_scores[indices[3 * adjacent + 1]] +
+				                            vertex_scores[indices[3 * adjacent + 2]];
+				if (triangle_scores[adjacent] > best_score)
+				{
+					best_score = triangle_scores[adjacent];
+					best_triangle = adjacent;
+				}
+			}
+		}
+
+		if (new_cache.size() > forsyth_cache_size)
+		{
+			new_cache.resize(forsyth_cache_size);
+		}
+		std::swap(cache, new_cache);
+	}
+
+	indices = std::move(result);
+}
+
+void optimize_overdraw(std::vector<u32> &indices, const std::vector<vertex> &vertices, u32 cache_size)
+{
+	const u32 triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	/* Split into clusters where the cache restarts, i.e. a triangle misses all of its vertices. Reordering
+	 * clusters then keeps the vertex cache efficiency of the input order. */
+	std::vector<u32> cluster_offsets = {};
+	{
+		std::vector<u32> timestamps(vertices.size(), 0);
+		u32 time = cache_size + 1;
+		for (u32 t = 0; t < triangle_count; ++t)
+		{
+			u32 misses = 0;
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const u32 index = indices[3 * t + k];
+				if (time - timestamps[index] > cache_size)
+				{
+					timestamps[index] = time++;
+					++misses;
+				}
+			}
+			if (t == 0 || misses == 3)
+			{
+				cluster_offsets.push_back(t);
+			}
+		}
+		cluster_offsets.push_back(triangle_count);
+	}
+	const u32 cluster_count = cluster_offsets.size() - 1;
+
+	/* Area weighted centroid and normal per cluster. */
+	std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.0f));
+	std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.0f));
+	glm::vec3 mesh_centroid = glm::vec3(0.0f);
+	float mesh_area = 0.0f;
+	for (u32 c = 0; c < cluster_count; ++c)
+	{
+		float cluster_area = 0.0f;
+		for (u32 t = cluster_offsets[c]; t < cluster_offsets[c + 1]; ++t)
+		{
+			const glm::vec3 &p0 = vertices[indices[3 * t + 0]].position;
+			const glm::vec3 &p1 = vertices[indices[3 * t + 1]].position;
+			const glm::vec3 &p2 = vertices[indices[3 * t + 2]].position;
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(normal);
+			cluster_centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+			cluster_normals[c] += normal;
+			cluster_area += area;
+		}
+		mesh_centroid += cluster_centroids[c];
+		mesh_area += cluster_area;
+		cluster_centroids[c] = cluster_area > 0.0f ? cluster_centroids[c] / cluster_area : glm::vec3(0.0f);
+	}
+	mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : glm::vec3(0.0f);
+
+	/* Clusters facing away from the center tend to occlude the rest of the mesh, draw those first. */
+	std::vector<float> sort_keys(cluster_count);
+	for (u32 c = 0; c < cluster_count; ++c)
+	{
+		const float normal_length = glm::length(cluster_normals[c]);
+		const glm::vec3 normal = normal_length > 0.0f ? cluster_normals[c] / normal_length : glm::vec3(0.0f);
+		sort_keys[c] = glm::dot(cluster_centroids[c] - mesh_centroid, normal);
+	}
+	std::vector<u32> cluster_order(cluster_count);
+	for (u32 c = 0; c < cluster_count; ++c)
+	{
+		cluster_order[c] = c;
+	}
+	std::stable_sort(cluster_order.begin(), cluster_order.end(),
+	                 [&](u32 a, u32 b) { return sort_keys[a] > sort_keys[b]; });
+
+	std::vector<u32> result = {};
+	result.reserve(indices.size());
+	for (u32 c : cluster_order)
+	{
+		result.insert(result.end(), indices.begin() + 3 * cluster_offsets[c],
+		              indices.begin() + 3 * cluster_offsets[c + 1]);
+	}
+	indices = std::move(result);
+}
+
+void optimize_vertex_fetch(std::vector<vertex> &vertices, std::vector<u32> &indices)
+{
+	/* Order vertices by first use, unreferenced vertices are dropped. */
+	constexpr u32 unused = ~0u;
+	std::vector<u32> remap(vertices.size(), unused);
+	std::vector<vertex> reordered_vertices = {};
+	reordered_vertices.reserve(vertices.size());
+	for (u32 &index : indices)
+	{
+		if (unused == remap[index])
+		{
+			remap[index] = reordered_vertices.size();
+			reordered_vertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(reordered_vertices);
+}
+
+void pack_indices(mesh &mesh)
+{
+	mesh.m_short_indices.clear();
+	if (mesh.m_vertices.size() <= (size_t)UINT16_MAX + 1)
+	{
+		mesh.m_short_indices.assign(mesh.m_indices.begin(), mesh.m_indices.end());
+	}
+}
+
+void optimize_mesh(mesh &mesh)
+{
+	/* Small FIFO for analysis, as a conservative model of real hardware. */
+	constexpr u32 analysis_cache_size = 16;
+
+	assert_if(mesh.m_indices.size() % 3 != 0, "Mesh optimization requires a triangle list");
+	mesh.m_statistics.vertex_count_before = mesh.m_vertices.size();
+	mesh.m_statistics.acmr_before = analyze_vertex_cache(mesh.m_indices, mesh.m_vertices.size(), analysis_cache_size);
+
+	weld_vertices(mesh.m_vertices, mesh.m_indices);
+	optimize_vertex_cache(mesh.m_indices, mesh.m_vertices.size());
+	optimize_overdraw(mesh.m_indices, mesh.m_vertices, analysis_cache_size);
+	optimize_vertex_fetch(mesh.m_vertices, mesh.m_indices);
+	pack_indices(mesh);
+
+	mesh.m_statistics.vertex_count_after = mesh.m_vertices.size();
+	mesh.m_statistics.acmr_after = analyze_vertex_cache(mesh.m_indices, mesh.m_vertices.size(), analysis_cache_size);
+}
+
+} /* namespace assets */
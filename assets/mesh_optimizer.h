@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include <utils/type.h>
+
+#include "model.h"
+
+namespace assets
+{
+
+/* Average cache miss ratio, i.e. transformed vertices per triangle, for a FIFO post-transform cache. */
+float analyze_vertex_cache(const std::vector<u32> &indices, u32 vertex_count, u32 cache_size);
+
+u32 weld_vertices(std::vector<vertex> &vertices, std::vector<u32> &indices);
+void optimize_vertex_cache(std::vector<u32> &indices, u32 vertex_count);
+void optimize_overdraw(std::vector<u32> &indices, const std::vector<vertex> &vertices, u32 cache_size);
+void optimize_vertex_fetch(std::vector<vertex> &vertices, std::vector<u32> &indices);
+void pack_indices(mesh &mesh);
+
+/* Runs all of the above in order and records before/after statistics in the mesh. */
+void optimize_mesh(mesh &mesh);
+
+} /* namespace assets */
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+#include <utils/util.h>
+
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+namespace assets
+{
+
+/* Area weighted sum of squared distances to a set of planes, as a symmetric 4x4 matrix. */
+struct quadric
+{
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+static void add_quadric(quadric &q, const quadric &other)
+{
+	q.a00 += other.a00;
+	q.a01 += other.a01;
+	q.a02 += other.a02;
+	q.a11 += other.a11;
+	q.a12 += other.a12;
+	q.a22 += other.a22;
+	q.b0 += other.b0;
+	q.b1 += other.b1;
+	q.b2 += other.b2;
+	q.c += other.c;
+	q.weight += other.weight;
+}
+
+static quadric get_plane_quadric(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+{
+	quadric q = {};
+	const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+	const double length = glm::length(normal);
+	if (length == 0.0)
+	{
+		return q;
+	}
+
+	const double nx = normal.x / length;
+	const double ny = normal.y / length;
+	const double nz = normal.z / length;
+	const double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+	const double w = length * 0.5;
+	q.a00 = nx * nx * w;
+	q.a01 = nx * ny * w;
+	q.a02 = nx * nz * w;
+	q.a11 = ny * ny * w;
+	q.a12 = ny * nz * w;
+	q.a22 = nz * nz * w;
+	q.b0 = nx * d * w;
+	q.b1 = ny * d * w;
+	q.b2 = nz * d * w;
+	q.c = d * d * w;
+	q.weight = w;
+	return q;
+}
+
+/* Mean squared distance from p to the planes in q. */
+static double get_quadric_error(const quadric &q, const glm::vec3 &p)
+{
+	const double x = p.x;
+	const double y = p.y;
+	const double z = p.z;
+	const double error = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + q.a11 * y * y +
+	                     2.0 * q.a12 * y * z + q.a22 * z * z + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+	return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+struct position_hash
+{
+	size_t operator()(const glm::vec3 &p) const
+	{
+		u32 bits[3];
+		memcpy(bits, &p, sizeof(bits));
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+struct position_equal
+{
+	bool operator()(const glm::vec3 &a, const glm::vec3 &b) const
+	{
+		return memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+	}
+};
+
+struct edge_collapse
+{
+	double cost;
+	u32 from;
+	u32 to;
+	u32 from_version;
+	u32 to_version;
+
+	bool operator>(const edge_collapse &other) const
+	{
+		return cost > other.cost;
+	}
+};
+
+std::vector<u32> simplify_mesh(const std::vector<vertex> &vertices, const std::vector<u32> &indices,
+                               u32 target_index_count, float target_error, float *result_error)
+{
+	const u32 vertex_count = vertices.size();
+	const u32 triangle_count = indices.size() / 3;
+
+	/* Vertices sharing a position are wedges of a single topological vertex, identified by its first wedge. */
+	std::vector<u32> position_ids(vertex_count);
+	std::vector<std::vector<u32>> wedges(vertex_count);
+	{
+		std::unordered_map<glm::vec3, u32, position_hash, position_equal> unique_positions = {};
+		unique_positions.reserve(vertex_count);
+		for (u32 v = 0; v < vertex_count; ++v)
+		{
+			auto [it, inserted] = unique_positions.try_emplace(vertices[v].position, v);
+			position_ids[v] = it->second;
+			wedges[it->second].push_back(v);
+		}
+	}
+
+	/* Lock attribute seams, open borders and non-manifold edges, collapsing those would tear the mesh. */
+	std::vector<bool> locked(vertex_count, false);
+	{
+		for (u32 v = 0; v < vertex_count; ++v)
+		{
+			locked[v] = wedges[v].size() > 1;
+		}
+
+		std::unordered_map<u64, u32> edge_use_counts = {};
+		edge_use_counts.reserve(indices.size());
+		for (u32 t = 0; t < triangle_count; ++t)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const u32 a = position_ids[indices[3 * t + k]];
+				const u32 b = position_ids[indices[3 * t + (k + 1) % 3]];
+				++edge_use_counts[(u64)std::min(a, b) << 32 | std::max(a, b)];
+			}
+		}
+		for (const auto &[edge, use_count] : edge_use_counts)
+		{
+			if (use_count != 2)
+			{
+				locked[edge >> 32] = true;
+				locked[edge & 0xffffffff] = true;
+			}
+		}
+	}
+
+	/* Quadrics and triangle adjacency per topological vertex. */
+	std::vector<quadric> quadrics(vertex_count, quadric{});
+	std::vector<std::vector<u32>> vertex_triangles(vertex_count);
+	for (u32 t = 0; t < triangle_count; ++t)
+	{
+		const quadric q = get_plane_quadric(vertices[indices[3 * t + 0]].position,
+		                                    vertices[indices[3 * t + 1]].position,
+		                                    vertices[indices[3 * t + 2]].position);
+		for (u32 k = 0; k < 3; ++k)
+		{
+			add_quadric(quadrics[position_ids[indices[3 * t + k]]], q);
+			vertex_triangles[position_ids[indices[3 * t + k]]].push_back(t);
+		}
+	}
+
+	std::vector<u32> corners = indices;
+	std::vector<bool> removed(triangle_count, false);
+	std::vector<u32> versions(vertex_count, 0);
+	std::priority_queue<edge_collapse, std::vector<edge_collapse>, std::greater<edge_collapse>> collapses = {};
+
+	auto push_collapse = [&](u32 from, u32 to)
+	{
+		if (locked[from])
+		{
+			return;
+		}
+		quadric q = quadrics[from];
+		add_quadric(q, quadrics[to]);
+		collapses.push({ get_quadric_error(q, vertices[to].position), from, to, versions[from], versions[to] });
+	};
+	auto push_collapses = [&](u32 v)
+	{
+		for (u32 t : vertex_triangles[v])
+		{
+			if (removed[t])
+			{
+				continue;
+			}
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const u32 u = position_ids[corners[3 * t + k]];
+				if (u != v)
+				{
+					push_collapse(v, u);
+					push_collapse(u, v);
+				}
+			}
+		}
+	};
+	for (u32 v = 0; v < vertex_count; ++v)
+	{
+		if (position_ids[v] == v)
+		{
+			push_collapses(v);
+		}
+	}
+
+	const double target_cost = (double)target_error * (double)target_error;
+	double max_cost = 0.0;
+	u32 live_triangle_count = triangle_count;
+	while (live_triangle_count * 3 > target_index_count && !collapses.empty())
+	{
+		const edge_collapse collapse = collapses.top();
+		collapses.pop();
+		if (collapse.from_version != versions[collapse.from] || collapse.to_version != versions[collapse.to])
+		{
+			/* Stale, either endpoint changed since this was queued. */
+			continue;
+		}
+		if (collapse.cost > target_cost)
+		{
+			break;
+		}
+
+		/* Reject collapses that flip or squash any of the remaining triangles around the removed vertex. */
+		const glm::vec3 &target_position = vertices[collapse.to].position;
+		bool flips = false;
+		for (u32 t : vertex_triangles[collapse.from])
+		{
+			if (removed[t])
+			{
+				continue;
+			}
+
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			bool contains_target = false;
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const u32 v = position_ids[corners[3 * t + k]];
+				before[k] = vertices[v].position;
+				after[k] = v == collapse.from ? target_position : before[k];
+				contains_target |= v == collapse.to;
+			}
+			if (contains_target)
+			{
+				continue;
+			}
+
+			const glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+			const glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+			const float length_product = glm::length(normal_before) * glm::length(normal_after);
+			if (length_product == 0.0f || glm::dot(normal_before, normal_after) < 0.25f * length_product)
+			{
+				flips = true;
+				break;
+			}
+		}
+		if (flips)
+		{
+			continue;
+		}
+
+		/* Collapse, triangles with both endpoints disappear and the rest move to the closest target wedge. */
+		for (u32 t : vertex_triangles[collapse.from])
+		{
+			if (removed[t])
+			{
+				continue;
+			}
+
+			bool contains_target = false;
+			for (u32 k = 0; k < 3; ++k)
+			{
+				contains_target |= position_ids[corners[3 * t + k]] == collapse.to;
+			}
+			if (contains_target)
+			{
+				removed[t] = true;
+				--live_triangle_count;
+				continue;
+			}
+
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const u32 corner = corners[3 * t + k];
+				if (position_ids[corner] != collapse.from)
+				{
+					continue;
+				}
+
+				float best_distance = INFINITY;
+				for (u32 wedge : wedges[collapse.to])
+				{
+					const glm::vec2 uv_delta = { vertices[wedge].uv.x - vertices[corner].uv.x,
+						                         vertices[wedge].uv.y - vertices[corner].uv.y };
+					const glm::vec3 normal_delta = vertices[wedge].normal - vertices[corner].normal;
+					const float distance = uv_delta.x * uv_delta.x + uv_delta.y * uv_delta.y +
+					                       glm::dot(normal_delta, normal_delta);
+					if (distance < best_distance)
+					{
+						best_distance = distance;
+						corners[3 * t + k] = wedge;
+					}
+				}
+			}
+			vertex_triangles[collapse.to].push_back(t);
+		}
+
+		add_quadric(quadrics[collapse.to], quadrics[collapse.from]);
+		vertex_triangles[collapse.from].clear();
+		++versions[collapse.from];
+		++versions[collapse.to];
+		max_cost = std::max(max_cost, collapse.cost);
+		push_collapses(collapse.to);
+	}
+
+	std::vector<u32> result = {};
+	result.reserve(live_triangle_count * 3);
+	for (u32 t = 0; t < triangle_count; ++t)
+	{
+		if (!removed[t])
+		{
+			result.insert(result.end(), corners.begin() + 3 * t, corners.begin() + 3 * t + 3);
+		}
+	}
+
+	if (nullptr != result_error)
+	{
+		*result_error = (float)std::sqrt(max_cost);
+	}
+	return result;
+}
+
+void generate_lods(mesh &mesh)
+{
+	/* Each LOD targets half the triangles of the previous one, bounded by a fraction of the mesh extent. */
+	constexpr u32 max_lod_count = 6;
+	constexpr float max_relative_error = 0.02f;
+	constexpr float min_reduction = 0.85f;
+
+	mesh.m_lods.clear();
+	const u32 base_index_count = mesh.m_indices.size();
+	mesh.m_lods.push_back({ .first_index = 0, .index_count = base_index_count, .error = 0.0f });
+	if (base_index_count == 0)
+	{
+		return;
+	}
+
+	glm::vec3 min = mesh.m_vertices[0].position;
+	glm::vec3 max = mesh.m_vertices[0].position;
+	for (const vertex &vertex : mesh.m_vertices)
+	{
+		min = glm::min(min, vertex.position);
+		max = glm::max(max, vertex.position);
+	}
+	const float target_error = glm::length(max - min) * max_relative_error;
+
+	/* Simplify each LOD from the previous one to keep import time down, errors accumulate. */
+	std::vector<u32> lod_indices = mesh.m_indices;
+	for (u32 lod = 1; lod < max_lod_count; ++lod)
+	{
+		const float remaining_error = target_error - mesh.m_lods.back().error;
+		const u32 target_index_count = (base_index_count >> lod) / 3 * 3;
+		float error = 0.0f;
+		lod_indices = simplify_mesh(mesh.m_vertices, lod_indices, target_index_count, remaining_error, &error);
+		if (lod_indices.empty() || (float)lod_indices.size() > min_reduction * (float)mesh.m_lods.back().index_count)
+		{
+			/* Simplification is stuck on locked vertices or the error bound. */
+			break;
+		}
+
+		optimize_vertex_cache(lod_indices, mesh.m_vertices.size());
+		mesh.m_lods.push_back({ .first_index = (u32)mesh.m_indices.size(),
+		                        .index_count = (u32)lod_indices.size(),
+		                        .error = mesh.m_lods.back().error + error });
+		mesh.m_indices.insert(mesh.m_indices.end(), lod_indices.begin(), lod_indices.end());
+	}
+
+	pack_indices(mesh);
+}
+
+} /* namespace assets */
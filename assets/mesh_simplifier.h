@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include <utils/type.h>
+
+#include "model.h"
+
+namespace assets
+{
+
+/* Quadric edge-collapse simplification towards target_index_count, never exceeding target_error. Collapses
+ * are restricted to existing vertices, so the returned indices reference the input vertices. Open borders
+ * and attribute seams are kept in place. The resulting geometric error, in model space, is written to
+ * result_error. */
+std::vector<u32> simplify_mesh(const std::vector<vertex> &vertices, const std::vector<u32> &indices,
+                               u32 target_index_count, float target_error, float *result_error);
+
+/* Appends a chain of simplified LODs to the mesh index buffer and fills mesh::m_lods. */
+void generate_lods(mesh &mesh);
+
+} /* namespace assets */
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+
+#include "meshlet_builder.h"
+
+namespace assets
+{
+
+void compute_meshlet_bounds(const mesh &mesh, meshlet &meshlet)
+{
+	/* Sphere centered on the box of the meshlet vertices. */
+	glm::vec3 min = mesh.m_vertices[mesh.m_meshlet_vertices[meshlet.vertex_offset]].position;
+	glm::vec3 max = min;
+	for (u32 v = 0; v < meshlet.vertex_count; ++v)
+	{
+		const glm::vec3 &position = mesh.m_vertices[mesh.m_meshlet_vertices[meshlet.vertex_offset + v]].position;
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+	const glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (u32 v = 0; v < meshlet.vertex_count; ++v)
+	{
+		const glm::vec3 &position = mesh.m_vertices[mesh.m_meshlet_vertices[meshlet.vertex_offset + v]].position;
+		radius = std::max(radius, glm::length(position - center));
+	}
+	meshlet.sphere = glm::vec4(center, radius);
+
+	/* Normal cone around the average counter-clockwise face normal, degenerate triangles are ignored. */
+	std::vector<glm::vec3> normals = {};
+	normals.reserve(meshlet.triangle_count);
+	glm::vec3 axis = glm::vec3(0.0f);
+	for (u32 t = 0; t < meshlet.triangle_count; ++t)
+	{
+		const u32 packed = mesh.m_meshlet_triangles[meshlet.triangle_offset + t];
+		glm::vec3 positions[3];
+		for (u32 c = 0; c < 3; ++c)
+		{
+			const u32 local = (packed >> (8 * c)) & 0xff;
+			positions[c] = mesh.m_vertices[mesh.m_meshlet_vertices[meshlet.vertex_offset + local]].position;
+		}
+		const glm::vec3 normal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+		const float length = glm::length(normal);
+		if (length > 0.0f)
+		{
+			normals.push_back(normal / length);
+			axis += normals.back();
+		}
+	}
+
+	/* The cone of view directions that see only back faces is the normal cone widened by 90 degrees and inverted,
+	 * its cutoff is sin(a) for a normal cone half-angle a. Wide cones are rarely culled and left at 1. */
+	meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	const float axis_length = glm::length(axis);
+	if (axis_length == 0.0f)
+	{
+		return;
+	}
+	axis /= axis_length;
+	float min_dot = 1.0f;
+	for (const glm::vec3 &normal : normals)
+	{
+		min_dot = std::min(min_dot, glm::dot(axis, normal));
+	}
+	constexpr float min_cone_dot = 0.1f;
+	if (min_dot > min_cone_dot)
+	{
+		meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - min_dot * min_dot));
+	}
+}
+
+void build_meshlets(mesh &mesh)
+{
+	mesh.m_meshlets.clear();
+	mesh.m_meshlet_vertices.clear();
+	mesh.m_meshlet_triangles.clear();
+
+	const u32 first_index = mesh.m_lods.empty() ? 0 : mesh.m_lods[0].first_index;
+	const u32 index_count = mesh.m_lods.empty() ? (u32)mesh.m_indices.size() : mesh.m_lods[0].index_count;
+
+	/* Local index of each vertex, valid if the vertex was added to the current meshlet. */
+	std::vector<u32> vertex_meshlets(mesh.m_vertices.size(), ~0u);
+	std::vector<u8> local_indices(mesh.m_vertices.size(), 0);
+
+	meshlet current = {};
+	const auto finish_meshlet = [&]()
+	{
+		if (current.triangle_count == 0)
+		{
+			return;
+		}
+		compute_meshlet_bounds(mesh, current);
+		mesh.m_meshlets.push_back(current);
+		current = { .vertex_offset = (u32)mesh.m_meshlet_vertices.size(),
+			        .triangle_offset = (u32)mesh.m_meshlet_triangles.size() };
+	};
+
+	for (u32 i = first_index; i < first_index + index_count; i += 3)
+	{
+		const u32 *triangle = &mesh.m_indices[i];
+		const u32 meshlet_index = mesh.m_meshlets.size();
+
+		/* Count distinct vertices not yet in the meshlet, degenerate triangles may repeat one. */
+		u32 new_vertex_count = 0;
+		for (u32 c = 0; c < 3; ++c)
+		{
+			const bool repeated = (c > 0 && triangle[c] == triangle[0]) || (c > 1 && triangle[c] == triangle[1]);
+			if (!repeated && vertex_meshlets[triangle[c]] != meshlet_index)
+			{
+				++new_vertex_count;
+			}
+		}
+		if (current.vertex_count + new_vertex_count > meshlet_max_vertices ||
+		    current.triangle_count == meshlet_max_triangles)
+		{
+			finish_meshlet();
+		}
+
+		const u32 current_index = mesh.m_meshlets.size();
+		u32 packed = 0;
+		for (u32 c = 0; c < 3; ++c)
+		{
+			const u32 v = triangle[c];
+			if (vertex_meshlets[v] != current_index)
+			{
+				vertex_meshlets[v] = current_index;
+				local_indices[v] = (u8)current.vertex_count++;
+				mesh.m_meshlet_vertices.push_back(v);
+			}
+			packed |= (u32)local_indices[v] << (8 * c);
+		}
+		mesh.m_meshlet_triangles.push_back(packed);
+		++current.triangle_count;
+	}
+	finish_meshlet();
+}
+
+} /* namespace assets */
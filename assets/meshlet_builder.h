@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include <utils/type.h>
+
+#include "model.h"
+
+namespace assets
+{
+
+/* Limits of one meshlet, must match the output declaration of meshlet.mesh. */
+constexpr u32 meshlet_max_vertices = 64;
+constexpr u32 meshlet_max_triangles = 124;
+
+/* Bounding sphere and normal cone of the triangles of a meshlet. */
+void compute_meshlet_bounds(const mesh &mesh, meshlet &meshlet);
+
+/* Splits the first LOD into meshlets in index order, so the vertex cache order keeps them spatially coherent, and
+ * fills mesh::m_meshlets, mesh::m_meshlet_vertices and mesh::m_meshlet_triangles. */
+void build_meshlets(mesh &mesh);
+
+} /* namespace assets */
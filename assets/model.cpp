@@ -1,8 +1,12 @@
+#include <algorithm>
+#include <string>
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Weverything"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <third_party/stb/stb_image.h>
 #pragma clang diagnostic pop
@@ -11,6 +15,9 @@
 #include <utils/type.h>
 #include <utils/util.h>
 
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet_builder.h"
 #include "model.h"
 
 const aiNode *find_mesh_node(const aiScene *scene, const aiNode *node, const aiMesh *mesh)
@@ -41,7 +48,7 @@ namespace assets
 void model::load(const char *path)
 {
 	Assimp::Importer importer = {};
-	const aiScene *scene = importer.ReadFile(path, aiProcess_FlipUVs);
+	const aiScene *scene = importer.ReadFile(path, aiProcess_FlipUVs | aiProcess_Triangulate);
 	assert_if(nullptr == scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || nullptr == scene->mRootNode,
 	          "Assimp could not load %s", path);
 
@@ -86,8 +93,8 @@ void model::load(const char *path)
 			}
 			else
 			{
-				float random_color = random_float();
-				vertex.color = { random_color, random_color, random_color, 1.0f };
+				/* Constant color, a per-vertex random color would prevent welding. */
+				vertex.color = { 1.0f, 1.0f, 1.0f, 1.0f };
 			}
 
 			mesh.m_vertices.push_back(vertex);
@@ -103,27 +110,56 @@ void model::load(const char *path)
 			}
 		}
 
-		/* Add material. */
+		/* Optimize for the post-transform cache, overdraw and vertex fetch. */
+		optimize_mesh(mesh);
+		logger::info("Optimized %s mesh %u: %u -> %u vertices, ACMR %.3f -> %.3f", path, mesh_idx,
+		             mesh.m_statistics.vertex_count_before, mesh.m_statistics.vertex_count_after,
+		             mesh.m_statistics.acmr_before, mesh.m_statistics.acmr_after);
+
+		/* Generate simplified LODs, appended to the index buffer. */
+		generate_lods(mesh);
+		logger::info("Generated %u LODs for %s mesh %u, coarsest has %u triangles", (u32)mesh.m_lods.size(), path,
+		             mesh_idx, mesh.m_lods.back().index_count / 3);
+
+		/* Split the first LOD into meshlets for mesh shading. */
+		build_meshlets(mesh);
+		logger::info("Built %u meshlets for %s mesh %u", (u32)mesh.m_meshlets.size(), path, mesh_idx);
+
+		/* Add bounds. */
+		mesh.m_bounds = compute_bounds(mesh.m_vertices);
+
+		/* Add material, embedded glTF textures are referenced as "*<index>". */
 		constexpr u32 texture_idx = 0;
 		aiString texture_path = {};
 		if (AI_SUCCESS == assimp_material->GetTexture(aiTextureType_DIFFUSE, texture_idx, &texture_path))
 		{
-			/* Validate texture. */
-			aiTexture *texture = scene->mTextures[texture_idx];
-			assert_if(nullptr == texture, "Assimp could not get diffuse aiTexture for %s, mesh %u", path, mesh_idx);
-			assert_if(texture->mHeight != 0, "Found raw texture data with Assimp, handling not implemented");
-
-			/* Decode texture data. */
 			int channels;
-			stbi_uc *texture_data = stbi_load_from_memory((u8 *)texture->pcData, /* len = */ texture->mWidth,
-			                                              &mesh.m_width, &mesh.m_height, &channels, STBI_rgb_alpha);
-			assert_if(nullptr == texture_data, "stbi_load_from_memory could not load texture for model %s", path);
+			stbi_uc *texture_data = nullptr;
+			const aiTexture *texture = scene->GetEmbeddedTexture(texture_path.C_Str());
+			if (nullptr != texture)
+			{
+				assert_if(texture->mHeight != 0, "Found raw texture data with Assimp, handling not implemented");
+				texture_data = stbi_load_from_memory((u8 *)texture->pcData, /* len = */ texture->mWidth,
+				                                     &mesh.m_width, &mesh.m_height, &channels, STBI_rgb_alpha);
+			}
+			else
+			{
+				/* External texture, relative to the model file. */
+				const std::string model_path = path;
+				const size_t separator = model_path.find_last_of('/');
+				const std::string directory =
+				    std::string::npos == separator ? std::string() : model_path.substr(0, separator + 1);
+				const std::string image_path = directory + texture_path.C_Str();
+				texture_data = stbi_load(image_path.c_str(), &mesh.m_width, &mesh.m_height, &channels, STBI_rgb_alpha);
+			}
+			assert_if(nullptr == texture_data, "stbi could not load texture %s for model %s", texture_path.C_Str(),
+			          path);
 			mesh.m_texture.assign(texture_data, texture_data + mesh.m_width * mesh.m_height * 4);
 			stbi_image_free(texture_data);
 		}
 		else
 		{
-			assert_if(true, "Assimp could not get diffuse texture for %s, mesh %u", path, mesh_idx);
+			logger::warn("No diffuse texture for %s, mesh %u", path, mesh_idx);
 		}
 
 		/* Add transform. */
@@ -198,4 +234,65 @@ void model::generate_plane()
 	mesh.m_vertices.push_back({ v4, /* normal = */ {}, /* texture = */ {}, /* color = */ {} });
 }
 
+std::vector<packed_vertex> pack_vertices(const std::vector<vertex> &vertices)
+{
+	std::vector<packed_vertex> packed_vertices(vertices.size());
+	for (size_t v_idx = 0; v_idx < vertices.size(); ++v_idx)
+	{
+		const vertex &vertex = vertices[v_idx];
+		packed_vertex &packed_vertex = packed_vertices[v_idx];
+
+		packed_vertex.position[0] = glm::packHalf1x16(vertex.position.x);
+		packed_vertex.position[1] = glm::packHalf1x16(vertex.position.y);
+		packed_vertex.position[2] = glm::packHalf1x16(vertex.position.z);
+		packed_vertex.position[3] = glm::packHalf1x16(1.0f);
+
+		packed_vertex.uv[0] = glm::packHalf1x16(vertex.uv.x);
+		packed_vertex.uv[1] = glm::packHalf1x16(vertex.uv.y);
+
+		for (u32 c = 0; c < 4; ++c)
+		{
+			packed_vertex.color[c] = glm::packUnorm1x8(vertex.color[c]);
+		}
+	}
+	return packed_vertices;
+}
+
+std::vector<packed_position> pack_positions(const std::vector<vertex> &vertices)
+{
+	std::vector<packed_position> packed_positions(vertices.size());
+	for (size_t v_idx = 0; v_idx < vertices.size(); ++v_idx)
+	{
+		packed_positions[v_idx].position[0] = glm::packHalf1x16(vertices[v_idx].position.x);
+		packed_positions[v_idx].position[1] = glm::packHalf1x16(vertices[v_idx].position.y);
+		packed_positions[v_idx].position[2] = glm::packHalf1x16(vertices[v_idx].position.z);
+		packed_positions[v_idx].position[3] = glm::packHalf1x16(1.0f);
+	}
+	return packed_positions;
+}
+
+mesh_bounds compute_bounds(const std::vector<vertex> &vertices)
+{
+	mesh_bounds bounds = {};
+	if (vertices.empty())
+	{
+		return bounds;
+	}
+
+	bounds.min = vertices[0].position;
+	bounds.max = vertices[0].position;
+	for (const vertex &vertex : vertices)
+	{
+		bounds.min = glm::min(bounds.min, vertex.position);
+		bounds.max = glm::max(bounds.max, vertex.position);
+	}
+
+	bounds.center = (bounds.min + bounds.max) * 0.5f;
+	for (const vertex &vertex : vertices)
+	{
+		bounds.radius = std::max(bounds.radius, glm::length(vertex.position - bounds.center));
+	}
+	return bounds;
+}
+
 } /* namespace assets */
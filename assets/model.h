@@ -16,9 +16,66 @@ struct vertex
 };
 static_assert(sizeof(vertex) == 48, "Unexpected struct vertex size");
 
+/* Compact vertex layout uploaded to the GPU, see assets::pack_vertices. Normals are left out until shading uses
+ * them. */
+struct packed_vertex
+{
+	u16 position[4]; /* Half-float xyz, w is padding. */
+	u16 uv[2];       /* Half-float. */
+	u8 color[4];     /* unorm8. */
+};
+static_assert(sizeof(packed_vertex) == 16, "Unexpected struct packed_vertex size");
+
+/* Position-only vertex stream for depth-only passes, same encoding as packed_vertex::position. */
+struct packed_position
+{
+	u16 position[4]; /* Half-float xyz, w is padding. */
+};
+static_assert(sizeof(packed_position) == 8, "Unexpected struct packed_position size");
+
 namespace assets
 {
 
+struct mesh_statistics
+{
+	u32 vertex_count_before = 0;
+	u32 vertex_count_after = 0;
+	float acmr_before = 0.0f;
+	float acmr_after = 0.0f;
+};
+
+/* Range of mesh::m_indices for one level of detail, error is the geometric deviation in model space. */
+struct mesh_lod
+{
+	u32 first_index = 0;
+	u32 index_count = 0;
+	float error = 0.0f;
+};
+
+/* Cluster of the first LOD for mesh shading, see assets::build_meshlets. Vertices are ranges of
+ * mesh::m_meshlet_vertices, triangles are ranges of mesh::m_meshlet_triangles with three 8-bit local vertex indices
+ * each. Triangles all face away from any point p with dot(p - center, axis) >= cutoff * length(p - center) + radius,
+ * a cutoff of 1 never culls. */
+struct meshlet
+{
+	glm::vec4 sphere = {}; /* Model space center and radius. */
+	glm::vec4 cone = {};   /* Model space axis and cutoff. */
+	u32 vertex_offset = 0;
+	u32 triangle_offset = 0;
+	u32 vertex_count = 0;
+	u32 triangle_count = 0;
+};
+static_assert(sizeof(meshlet) == 48, "Unexpected struct meshlet size");
+
+/* Model space bounds, the sphere is centered on the box. */
+struct mesh_bounds
+{
+	glm::vec3 min = {};
+	glm::vec3 max = {};
+	glm::vec3 center = {};
+	float radius = 0.0f;
+};
+
 class mesh
 {
 public:
@@ -30,6 +87,13 @@ public:
 
 	std::vector<vertex> m_vertices = {};
 	std::vector<u32> m_indices = {};
+	std::vector<u16> m_short_indices = {}; /* Copy of m_indices if all vertices are 16-bit addressable. */
+	mesh_statistics m_statistics = {};
+	std::vector<mesh_lod> m_lods = {};
+	std::vector<meshlet> m_meshlets = {};
+	std::vector<u32> m_meshlet_vertices = {};
+	std::vector<u32> m_meshlet_triangles = {};
+	mesh_bounds m_bounds = {};
 
 	std::vector<u8> m_texture = {};
 	int m_width = -1;
@@ -58,4 +122,8 @@ public:
 private:
 };
 
+std::vector<packed_vertex> pack_vertices(const std::vector<vertex> &vertices);
+std::vector<packed_position> pack_positions(const std::vector<vertex> &vertices);
+mesh_bounds compute_bounds(const std::vector<vertex> &vertices);
+
 } /* namespace assets */
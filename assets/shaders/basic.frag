@@ -1,30 +1,31 @@
 #version 460
 
+#extension GL_EXT_nonuniform_qualifier : require
+
 layout(location = 0) in vec2 uv;
 
 layout(location = 0) out vec4 out_color;
 
-layout(std140, set = 0, binding = 0) uniform uniforms_block
-{
-	mat4 view;
-	mat4 projection;
-	uint enable_mipmapping;
-} scene_uniforms;
-layout(set = 0, binding = 1) uniform sampler2D diffuse;
+/* Set by static_model::update_material, each value is its own pipeline without a branch. */
+layout(constant_id = 0) const bool enable_mipmapping = true;
+
+/* Bindless table, see vulkan::bindless_table. */
+layout(set = 0, binding = 0) uniform sampler2D textures[];
 
-layout(push_constant) uniform push_constants_block
+/* Material set of the submesh, see static_model::material_uniform_binding. */
+layout(std140, set = 2, binding = 0) uniform material_block
 {
-	mat4 model;
-} object_uniforms;
+	uint diffuse_texture;
+} material;
 
 void main()
 {
-	if (scene_uniforms.enable_mipmapping == 0u)
+	if (!enable_mipmapping)
 	{
-		out_color = textureLod(diffuse, uv, 0);
+		out_color = textureLod(textures[material.diffuse_texture], uv, 0);
 	}
 	else
 	{
-		out_color = texture(diffuse, uv);
+		out_color = texture(textures[material.diffuse_texture], uv);
 	}
 }
@@ -1,26 +1,30 @@
 #version 460
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uv_in;
-layout(location = 3) in vec4 color;
+layout(location = 1) in vec2 uv_in;
+layout(location = 2) in vec4 color;
+
+/* Per-instance model matrix, one column per location. */
+layout(location = 3) in vec4 instance_model_0;
+layout(location = 4) in vec4 instance_model_1;
+layout(location = 5) in vec4 instance_model_2;
+layout(location = 6) in vec4 instance_model_3;
 
 layout(location = 0) out vec2 uv_out;
 
-layout(std140, set = 0, binding = 0) uniform ubo_block
+layout(std140, set = 1, binding = 0) uniform ubo_block
 {
 	mat4 view;
 	mat4 projection;
 	uint enable_mipmapping;
 } scene_uniforms;
 
-layout(push_constant) uniform push_constants_block
-{
-	mat4 model;
-} object_uniforms;
+/* Must match depth.vert exactly for the EQUAL depth test after a depth pre-pass. */
+invariant gl_Position;
 
 void main() {
+	const mat4 model = mat4(instance_model_0, instance_model_1, instance_model_2, instance_model_3);
 	uv_out = uv_in;
     gl_Position =
-		scene_uniforms.projection * scene_uniforms.view * object_uniforms.model * vec4(position, 1.0f);
+		scene_uniforms.projection * scene_uniforms.view * model * vec4(position, 1.0f);
 }
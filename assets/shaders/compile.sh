@@ -3,11 +3,15 @@
 set -e
 
 cd "$(dirname "$0")"
-IFS=$'\n' shaders=$(git ls-files --modified --others --exclude-standard)
-for shader in ${shaders[@]}; do
+shopt -s nullglob
+for shader in *.vert *.frag *.comp *.task *.mesh; do
 	case $shader in
-		*.vert | *.vert | *.comp)
+		*.task | *.mesh)
+			glslangValidator -V --target-env spirv1.4 "${shader}" -o "${shader}.spv"
+			;;
+		*)
 			glslangValidator -V "${shader}" -o "${shader}.spv"
 			;;
 	esac
+	spirv-val --target-env vulkan1.3 "${shader}.spv"
 done
@@ -0,0 +1,24 @@
+#version 460
+
+layout(location = 0) in vec3 position;
+
+/* Per-instance model matrix, one column per location. */
+layout(location = 1) in vec4 instance_model_0;
+layout(location = 2) in vec4 instance_model_1;
+layout(location = 3) in vec4 instance_model_2;
+layout(location = 4) in vec4 instance_model_3;
+
+layout(std140, set = 1, binding = 0) uniform ubo_block
+{
+	mat4 view;
+	mat4 projection;
+	uint enable_mipmapping;
+} scene_uniforms;
+
+/* Must match basic.vert exactly for the EQUAL depth test of the shading pass. */
+invariant gl_Position;
+
+void main() {
+	const mat4 model = mat4(instance_model_0, instance_model_1, instance_model_2, instance_model_3);
+	gl_Position = scene_uniforms.projection * scene_uniforms.view * model * vec4(position, 1.0f);
+}
@@ -5,7 +5,7 @@ layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 uv_in;
 layout(location = 3) in vec4 color;
 
-layout(std140, set = 0, binding = 0) uniform ubo_block
+layout(std140, set = 1, binding = 0) uniform ubo_block
 {
 	mat4 view;
 	mat4 projection;
@@ -1,12 +1,21 @@
 #version 460
 
+#extension GL_EXT_nonuniform_qualifier : require
+
 layout(location = 0) in vec3 direction;
 
 layout(location = 0) out vec4 out_color;
 
-layout(set = 0, binding = 1) uniform samplerCube skybox;
+/* Bindless table, see vulkan::bindless_table. */
+layout(set = 0, binding = 1) uniform samplerCube cube_textures[];
+
+/* Follows the model matrix pushed for the vertex stage. */
+layout(push_constant) uniform push_constants_block
+{
+	layout(offset = 64) uint texture_index;
+} object_uniforms;
 
 void main()
 {
-	out_color = texture(skybox, direction);
+	out_color = texture(cube_textures[object_uniforms.texture_index], direction);
 }
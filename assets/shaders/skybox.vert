@@ -2,7 +2,7 @@
 
 layout(location = 0) out vec3 direction;
 
-layout(std140, set = 0, binding = 0) uniform ubo_block
+layout(std140, set = 1, binding = 0) uniform ubo_block
 {
 	mat4 view;
 	mat4 projection;
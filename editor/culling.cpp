@@ -0,0 +1,167 @@
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CULLING_X86 1
+#else
+#define CULLING_X86 0
+#endif
+
+#include "culling.h"
+
+void aabb_soa::clear()
+{
+	m_center_x.clear();
+	m_center_y.clear();
+	m_center_z.clear();
+	m_extent_x.clear();
+	m_extent_y.clear();
+	m_extent_z.clear();
+}
+
+void aabb_soa::push_back(const glm::vec3 &center, const glm::vec3 &extent)
+{
+	m_center_x.push_back(center.x);
+	m_center_y.push_back(center.y);
+	m_center_z.push_back(center.z);
+	m_extent_x.push_back(extent.x);
+	m_extent_y.push_back(extent.y);
+	m_extent_z.push_back(extent.z);
+}
+
+void aabb_soa::set(u32 index, const glm::vec3 &center, const glm::vec3 &extent)
+{
+	m_center_x[index] = center.x;
+	m_center_y[index] = center.y;
+	m_center_z[index] = center.z;
+	m_extent_x[index] = extent.x;
+	m_extent_y[index] = extent.y;
+	m_extent_z[index] = extent.z;
+}
+
+u32 aabb_soa::size() const
+{
+	return m_center_x.size();
+}
+
+/* A box is outside a plane if its center is further behind it than the projected extent. */
+static u32 cull_aabbs_scalar(const glm::vec4 planes[6], const aabb_soa &aabbs, std::vector<u8> &visible, u32 begin)
+{
+	u32 visible_count = 0;
+	for (u32 i = begin; i < aabbs.size(); ++i)
+	{
+		bool inside = true;
+		for (u32 p = 0; p < 6 && inside; ++p)
+		{
+			const float distance = planes[p].x * aabbs.m_center_x[i] + planes[p].y * aabbs.m_center_y[i] +
+			                       planes[p].z * aabbs.m_center_z[i] + planes[p].w;
+			const float radius = std::abs(planes[p].x) * aabbs.m_extent_x[i] +
+			                     std::abs(planes[p].y) * aabbs.m_extent_y[i] +
+			                     std::abs(planes[p].z) * aabbs.m_extent_z[i];
+			inside = distance + radius >= 0.0f;
+		}
+		visible[i] = inside;
+		visible_count += inside;
+	}
+	return visible_count;
+}
+
+#if CULLING_X86
+
+static u32 cull_aabbs_sse(const glm::vec4 planes[6], const aabb_soa &aabbs, std::vector<u8> &visible)
+{
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const u32 simd_count = aabbs.size() & ~3u;
+	u32 visible_count = 0;
+	for (u32 i = 0; i < simd_count; i += 4)
+	{
+		const __m128 center_x = _mm_loadu_ps(&aabbs.m_center_x[i]);
+		const __m128 center_y = _mm_loadu_ps(&aabbs.m_center_y[i]);
+		const __m128 center_z = _mm_loadu_ps(&aabbs.m_center_z[i]);
+		const __m128 extent_x = _mm_loadu_ps(&aabbs.m_extent_x[i]);
+		const __m128 extent_y = _mm_loadu_ps(&aabbs.m_extent_y[i]);
+		const __m128 extent_z = _mm_loadu_ps(&aabbs.m_extent_z[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (u32 p = 0; p < 6; ++p)
+		{
+			const __m128 plane_x = _mm_set1_ps(planes[p].x);
+			const __m128 plane_y = _mm_set1_ps(planes[p].y);
+			const __m128 plane_z = _mm_set1_ps(planes[p].z);
+			__m128 distance = _mm_add_ps(_mm_mul_ps(plane_x, center_x), _mm_set1_ps(planes[p].w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(plane_y, center_y));
+			distance = _mm_add_ps(distance, _mm_mul_ps(plane_z, center_z));
+			__m128 radius = _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_x), extent_x);
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_y), extent_y));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_z), extent_z));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (u32 lane = 0; lane < 4; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+		visible_count += __builtin_popcount(mask);
+	}
+	return visible_count + cull_aabbs_scalar(planes, aabbs, visible, simd_count);
+}
+
+__attribute__((target("avx"))) static u32 cull_aabbs_avx(const glm::vec4 planes[6], const aabb_soa &aabbs,
+                                                           std::vector<u8> &visible)
+{
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+	const u32 simd_count = aabbs.size() & ~7u;
+	u32 visible_count = 0;
+	for (u32 i = 0; i < simd_count; i += 8)
+	{
+		const __m256 center_x = _mm256_loadu_ps(&aabbs.m_center_x[i]);
+		const __m256 center_y = _mm256_loadu_ps(&aabbs.m_center_y[i]);
+		const __m256 center_z = _mm256_loadu_ps(&aabbs.m_center_z[i]);
+		const __m256 extent_x = _mm256_loadu_ps(&aabbs.m_extent_x[i]);
+		const __m256 extent_y = _mm256_loadu_ps(&aabbs.m_extent_y[i]);
+		const __m256 extent_z = _mm256_loadu_ps(&aabbs.m_extent_z[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (u32 p = 0; p < 6; ++p)
+		{
+			const __m256 plane_x = _mm256_set1_ps(planes[p].x);
+			const __m256 plane_y = _mm256_set1_ps(planes[p].y);
+			const __m256 plane_z = _mm256_set1_ps(planes[p].z);
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(plane_x, center_x), _mm256_set1_ps(planes[p].w));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_y, center_y));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_z, center_z));
+			__m256 radius = _mm256_mul_ps(_mm256_andnot_ps(sign_mask, plane_x), extent_x);
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_andnot_ps(sign_mask, plane_y), extent_y));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_andnot_ps(sign_mask, plane_z), extent_z));
+			inside = _mm256_and_ps(inside,
+			                       _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		for (u32 lane = 0; lane < 8; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+		visible_count += __builtin_popcount(mask);
+	}
+	return visible_count + cull_aabbs_scalar(planes, aabbs, visible, simd_count);
+}
+
+#endif
+
+u32 cull_aabbs(const glm::vec4 planes[6], const aabb_soa &aabbs, std::vector<u8> &visible)
+{
+	visible.resize(aabbs.size());
+
+#if CULLING_X86
+	static const bool has_avx = __builtin_cpu_supports("avx");
+	if (has_avx)
+	{
+		return cull_aabbs_avx(planes, aabbs, visible);
+	}
+	return cull_aabbs_sse(planes, aabbs, visible);
+#else
+	return cull_aabbs_scalar(planes, aabbs, visible, 0);
+#endif
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <glm/glm.hpp>
+#pragma clang diagnostic pop
+
+#include <utils/type.h>
+
+/* Structure-of-arrays world space AABBs in center/extent form, laid out for SIMD frustum tests. */
+class aabb_soa
+{
+public:
+	aabb_soa() = default;
+	~aabb_soa() = default;
+
+	aabb_soa(const aabb_soa &) = delete;
+	aabb_soa operator=(const aabb_soa &) = delete;
+
+	void clear();
+	void push_back(const glm::vec3 &center, const glm::vec3 &extent);
+	void set(u32 index, const glm::vec3 &center, const glm::vec3 &extent);
+	u32 size() const;
+
+	std::vector<float> m_center_x = {};
+	std::vector<float> m_center_y = {};
+	std::vector<float> m_center_z = {};
+	std::vector<float> m_extent_x = {};
+	std::vector<float> m_extent_y = {};
+	std::vector<float> m_extent_z = {};
+};
+
+struct culling_statistics
+{
+	u32 tested = 0;
+	u32 visible = 0;
+};
+
+/* Tests every box against six inward-facing, normalized planes. visible[i] is set to 1 if box i intersects the
+ * frustum, 0 otherwise. Uses AVX or SSE when available, returns the number of visible boxes. */
+u32 cull_aabbs(const glm::vec4 planes[6], const aabb_soa &aabbs, std::vector<u8> &visible);
@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include <renderer/vulkan/context.h>
+#include <renderer/vulkan/util.h>
+
+#include "depth_pyramid.h"
+
+static constexpr u32 workgroup_size = 8;
+
+depth_pyramid::~depth_pyramid()
+{
+	if (VK_NULL_HANDLE != m_sampler)
+	{
+		vkDestroySampler(m_device_handle, m_sampler, nullptr);
+	}
+}
+
+void depth_pyramid::build(vulkan::context &context, u32 width, u32 height)
+{
+	if (VK_NULL_HANDLE == m_pipeline.m_handle)
+	{
+		m_device_handle = context.m_device.m_logical.m_handle;
+		m_pipeline.add_shader(context.m_device, "bin/assets/shaders/depth_pyramid.comp.spv");
+		m_pipeline.build(context.m_device);
+
+		/* Levels are read with texelFetch, the sampler only has to exist. */
+		const VkSamplerCreateInfo sampler_info = {
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,        //
+			.pNext = nullptr,                                      //
+			.flags = 0,                                            //
+			.magFilter = VK_FILTER_NEAREST,                        //
+			.minFilter = VK_FILTER_NEAREST,                        //
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,          //
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, //
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, //
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, //
+			.mipLodBias = 0.0f,                                    //
+			.anisotropyEnable = VK_FALSE,                          //
+			.maxAnisotropy = 0.0f,                                 //
+			.compareEnable = VK_FALSE,                             //
+			.compareOp = VK_COMPARE_OP_ALWAYS,                     //
+			.minLod = 0.0f,                                        //
+			.maxLod = VK_LOD_CLAMP_NONE,                           //
+			.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,     //
+			.unnormalizedCoordinates = VK_FALSE,                   //
+		};
+		VULKAN_ASSERT_SUCCESS(vkCreateSampler(m_device_handle, &sampler_info, nullptr, &m_sampler));
+	}
+
+	if (m_image && m_width == width && m_height == height)
+	{
+		return;
+	}
+	m_width = width;
+	m_height = height;
+	m_valid = false;
+
+	/* Views have to go before the image they reference. */
+	m_level_views.clear();
+	m_image_view.reset();
+	m_image = make_uref<vulkan::image>();
+	m_image->build(context.m_resource_allocator.m_allocator,
+	               { .m_format = VK_FORMAT_R32_SFLOAT,
+	                 .m_width = width,
+	                 .m_height = height,
+	                 .m_usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	                 .m_mipmapped = true });
+	m_image->transition_layout(context, VK_IMAGE_LAYOUT_GENERAL);
+
+	m_image_view = make_uref<vulkan::image_view>();
+	m_image_view->build(context.m_device, *m_image);
+	for (u32 level = 0; level < m_image->m_mip_levels; ++level)
+	{
+		m_level_views.push_back(make_uref<vulkan::image_view>());
+		m_level_views.back()->build(context.m_device, *m_image, level, 1);
+	}
+}
+
+void depth_pyramid::generate(vulkan::command_buffer &command_buffer, const vulkan::texture &depth)
+{
+	assert_if(depth.m_image.m_info.m_sample_count != VK_SAMPLE_COUNT_1_BIT, "Depth pyramid needs resolved depth");
+
+	command_buffer.bind_pipeline(m_pipeline);
+	depth_pyramid_constants constants = { .src_width = depth.m_image.m_info.m_width,
+		                                  .src_height = depth.m_image.m_info.m_height,
+		                                  .dst_width = m_width,
+		                                  .dst_height = m_height };
+	for (u32 level = 0; level < m_level_views.size(); ++level)
+	{
+		const vulkan::image_view &src = 0 == level ? depth.m_image_view : *m_level_views[level - 1];
+		command_buffer.set_sampled_image(0, src, m_sampler, VK_PIPELINE_BIND_POINT_COMPUTE);
+		command_buffer.set_storage_image(1, *m_level_views[level], VK_PIPELINE_BIND_POINT_COMPUTE);
+		vkCmdPushConstants(command_buffer.m_handle, m_pipeline.m_pipeline_layout.m_handle,
+		                   VK_SHADER_STAGE_COMPUTE_BIT, /* offset = */ 0, sizeof(constants), &constants);
+		command_buffer.dispatch((constants.dst_width + workgroup_size - 1) / workgroup_size,
+		                        (constants.dst_height + workgroup_size - 1) / workgroup_size, 1);
+		command_buffer.memory_barrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+		                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+
+		constants.src_width = constants.dst_width;
+		constants.src_height = constants.dst_height;
+		constants.dst_width = std::max(constants.dst_width / 2, 1u);
+		constants.dst_height = std::max(constants.dst_height / 2, 1u);
+	}
+	m_valid = true;
+}
+
+u32 depth_pyramid::get_level_count() const
+{
+	return m_image ? m_image->m_mip_levels : 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include <renderer/vulkan/command_buffer.h>
+#include <renderer/vulkan/image.h>
+#include <renderer/vulkan/pipeline.h>
+#include <utils/type.h>
+
+namespace vulkan
+{
+class context;
+}
+
+struct depth_pyramid_constants
+{
+	u32 src_width;
+	u32 src_height;
+	u32 dst_width;
+	u32 dst_height;
+};
+
+/* Hierarchical-Z buffer. Level 0 matches the viewport, every texel of the following levels holds the farthest
+ * depth of the texels it covers in the level below, see depth_pyramid.comp. */
+class depth_pyramid
+{
+public:
+	depth_pyramid() = default;
+	~depth_pyramid();
+
+	depth_pyramid(const depth_pyramid &) = delete;
+	depth_pyramid operator=(const depth_pyramid &) = delete;
+
+	/* Recreates the pyramid if the size changed, contents are invalidated. */
+	void build(vulkan::context &context, u32 width, u32 height);
+	void generate(vulkan::command_buffer &command_buffer, const vulkan::texture &depth);
+
+	u32 get_level_count() const;
+
+	u32 m_width = 0;
+	u32 m_height = 0;
+	uref<vulkan::image> m_image = {};
+	uref<vulkan::image_view> m_image_view = {}; /* All levels. */
+	std::vector<uref<vulkan::image_view>> m_level_views = {};
+	VkSampler m_sampler = VK_NULL_HANDLE;
+
+	/* Holds the depth of the last generated frame. */
+	bool m_valid = false;
+
+private:
+	vulkan::compute_pipeline m_pipeline = {};
+	VkDevice m_device_handle = {};
+};
@@ -3,12 +3,27 @@
 
 #include "editor.h"
 
+editor::~editor()
+{
+	/* The logger is destroyed before the context, which still logs on destruction. */
+	logger::register_logger(nullptr);
+}
+
 void editor::build_default_settings()
 {
 	/* No dependencies. */
 	m_settings.enable_mipmapping = true;
 	m_settings.enable_skybox = true;
 	m_settings.enable_grid = true;
+	m_settings.enable_lod = true;
+	m_settings.lod_error_threshold = 1.0f;
+	m_settings.enable_frustum_culling = true;
+	m_settings.enable_gpu_culling = false;
+	m_settings.enable_occlusion_culling = true;
+	m_settings.enable_command_caching = true;
+	m_settings.enable_depth_prepass = false;
+	m_settings.enable_mesh_shading = true;
+	m_settings.enable_shader_objects = false;
 	m_settings.sample_count = VK_SAMPLE_COUNT_4_BIT;
 
 	m_settings.viewport_x = 0;
@@ -41,10 +56,20 @@ void editor::build()
 
 	build_default_settings();
 	m_scene.build(m_context, m_settings);
+
+	/* Main pass begin, depth pre-pass end and main pass end. */
+	m_timestamps.build(m_context.m_device, 3);
 }
 
 void editor::update()
 {
+	/* The previous frame has finished, see context::end_frame. */
+	if (m_timestamps.read())
+	{
+		m_pass_timings.m_depth_prepass_ms = m_timestamps.get_elapsed_ms(0, 1);
+		m_pass_timings.m_shading_ms = m_timestamps.get_elapsed_ms(1, 2);
+	}
+
 	m_ui.generate_frame();
 	m_scene.update(m_context, m_settings);
 }
@@ -54,6 +79,11 @@ void editor::draw()
 	render_graph rg(m_context);
 	rg.reset();
 	{
+		render_pass &rp0 = rg.add_render_pass("rp0");
+		{
+			rp0.set_execution([&](vulkan::command_buffer &cmd_buf) { m_scene.cull_static_meshes(cmd_buf); });
+		}
+
 		render_pass &rp1 = rg.add_render_pass("rp1");
 		{
 			render_texture &viewport_color =
@@ -61,21 +91,37 @@ void editor::draw()
 			                                                .format = m_settings.color_format,
 			                                                .width = m_settings.viewport_width,
 			                                                .height = m_settings.viewport_height,
-			                                                .sample_count = m_settings.sample_count,
+			                                                .sample_count = m_scene.m_sample_count,
 			                                            });
 			render_texture &viewport_depth =
 			    rp1.add_depth_stencil_texture("viewport_depth", {
 			                                                        .format = m_settings.depth_format,
 			                                                        .width = m_settings.viewport_width,
 			                                                        .height = m_settings.viewport_height,
-			                                                        .sample_count = m_settings.sample_count,
+			                                                        .sample_count = m_scene.m_sample_count,
 			                                                    });
 			render_texture &viewport_resolve =
 			    rp1.add_resolve_texture("viewport_resolve", { .format = m_settings.color_format,
 			                                                  .width = m_settings.viewport_width,
 			                                                  .height = m_settings.viewport_height });
+
+			/* Occlusion culling builds its depth pyramid from single sampled depth halfway through the pass. */
+			const bool split = m_scene.m_occlusion_culling;
+			const bool resolve_depth = split && m_scene.m_sample_count != VK_SAMPLE_COUNT_1_BIT;
+			render_texture *occlusion_depth = nullptr;
+			if (resolve_depth)
+			{
+				rp1.add_depth_resolve_texture("viewport_depth_resolve", { .format = m_settings.depth_format,
+				                                                          .width = m_settings.viewport_width,
+				                                                          .height = m_settings.viewport_height });
+				occlusion_depth = &rp1.add_sampled_texture("viewport_depth_resolve");
+			}
+			else if (split)
+			{
+				occlusion_depth = &rp1.add_sampled_texture("viewport_depth");
+			}
 			rp1.set_execution(
-			    [&](vulkan::command_buffer &cmd_buf)
+			    [&, split, resolve_depth, occlusion_depth](vulkan::command_buffer &cmd_buf)
 			    {
 				    VkViewport viewport = { 0.0f,
 					                        (float)m_settings.viewport_height,
@@ -84,86 +130,109 @@ void editor::draw()
 					                        0.0f,
 					                        1.0f };
 				    VkRect2D scissor = { { 0.0f, 0.0f }, { m_settings.viewport_width, m_settings.viewport_height } };
-				    vkCmdSetViewport(cmd_buf.m_handle, 0, 1, &viewport);
-				    vkCmdSetScissor(cmd_buf.m_handle, 0, 1, &scissor);
+				    cmd_buf.set_shader_objects(m_scene.m_shader_objects);
+				    cmd_buf.set_viewport(viewport);
+				    cmd_buf.set_scissor(scissor);
 
-				    VkClearValue clear_color = {};
-				    clear_color.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				    const VkRenderingAttachmentInfo color_attachment = {
-					    .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,                  //
-					    .pNext = nullptr,                                                      //
-					    .imageView = viewport_color.m_texture->m_image_view.m_handle,          //
-					    .imageLayout = VK_IMAGE_LAYOUT_GENERAL,                                //
-					    .resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT,                            //
-					    .resolveImageView = viewport_resolve.m_texture->m_image_view.m_handle, //
-					    .resolveImageLayout = VK_IMAGE_LAYOUT_GENERAL,                         //
-					    .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,                                 //
-					    .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,                           //
-					    .clearValue = clear_color,                                             //
-				    };
-				    VkClearValue clear_depth = {};
-				    clear_depth.depthStencil = { 1.0f, 0 };
-				    const VkRenderingAttachmentInfo depth_attachment = {
-					    .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,         //
-					    .pNext = nullptr,                                             //
-					    .imageView = viewport_depth.m_texture->m_image_view.m_handle, //
-					    .imageLayout = VK_IMAGE_LAYOUT_GENERAL,                       //
-					    .resolveMode = VK_RESOLVE_MODE_NONE,                          //
-					    .resolveImageView = VK_NULL_HANDLE,                           //
-					    .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,              //
-					    .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,                        //
-					    .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,                  //
-					    .clearValue = clear_depth,                                    //
-				    };
-				    const VkRenderingInfo rendering_info = {
-					    .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,                                             //
-					    .pNext = nullptr,                                                                      //
-					    .flags = 0,                                                                            //
-					    .renderArea = { { 0, 0 }, { m_settings.viewport_width, m_settings.viewport_height } }, //
-					    .layerCount = 1,                                                                       //
-					    .viewMask = 0,                                                                         //
-					    .colorAttachmentCount = 1,                                                             //
-					    .pColorAttachments = &color_attachment,                                                //
-					    .pDepthAttachment = &depth_attachment,                                                 //
-					    .pStencilAttachment = nullptr,                                                         //
+				    /* The first half clears and stores, the second half loads and resolves. */
+				    const auto begin_rendering = [&](bool first, bool last, VkRenderingFlags flags)
+				    {
+					    VkClearValue clear_color = {};
+					    clear_color.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+					    const VkRenderingAttachmentInfo color_attachment = {
+						    .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,                              //
+						    .pNext = nullptr,                                                                  //
+						    .imageView = viewport_color.m_texture->m_image_view.m_handle,                      //
+						    .imageLayout = VK_IMAGE_LAYOUT_GENERAL,                                            //
+						    .resolveMode = last ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE,          //
+						    .resolveImageView = viewport_resolve.m_texture->m_image_view.m_handle,             //
+						    .resolveImageLayout = VK_IMAGE_LAYOUT_GENERAL,                                     //
+						    .loadOp = first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,        //
+						    .storeOp = last ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE, //
+						    .clearValue = clear_color,                                                         //
+					    };
+					    /* Depth is cleared to 1.0, so the farthest sample is the conservative one for occlusion. */
+					    const bool depth_resolve = resolve_depth && first && !last;
+					    VkResolveModeFlagBits depth_resolve_mode = VK_RESOLVE_MODE_NONE;
+					    if (depth_resolve)
+					    {
+						    const VkResolveModeFlags modes = m_context.m_device.m_features.m_depth_resolve_modes;
+						    depth_resolve_mode = modes & VK_RESOLVE_MODE_MAX_BIT ? VK_RESOLVE_MODE_MAX_BIT
+						                                                         : VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+					    }
+					    const VkImageView depth_resolve_view =
+					        depth_resolve ? occlusion_depth->m_texture->m_image_view.m_handle : VK_NULL_HANDLE;
+					    VkClearValue clear_depth = {};
+					    clear_depth.depthStencil = { 1.0f, 0 };
+					    const VkRenderingAttachmentInfo depth_attachment = {
+						    .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,                                  //
+						    .pNext = nullptr,                                                                      //
+						    .imageView = viewport_depth.m_texture->m_image_view.m_handle,                          //
+						    .imageLayout = VK_IMAGE_LAYOUT_GENERAL,                                                //
+						    .resolveMode = depth_resolve_mode,                                                     //
+						    .resolveImageView = depth_resolve_view,                                                //
+						    .resolveImageLayout = VK_IMAGE_LAYOUT_GENERAL,                                         //
+						    .loadOp = first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,            //
+						    .storeOp = last ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,     //
+						    .clearValue = clear_depth,                                                             //
+					    };
+					    const VkRenderingInfo rendering_info = {
+						    .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,                                             //
+						    .pNext = nullptr,                                                                      //
+						    .flags = flags,                                                                        //
+						    .renderArea = { { 0, 0 }, { m_settings.viewport_width, m_settings.viewport_height } }, //
+						    .layerCount = 1,                                                                       //
+						    .viewMask = 0,                                                                         //
+						    .colorAttachmentCount = 1,                                                             //
+						    .pColorAttachments = &color_attachment,                                                //
+						    .pDepthAttachment = &depth_attachment,                                                 //
+						    .pStencilAttachment = nullptr,                                                         //
+					    };
+					    vkCmdBeginRendering(cmd_buf.m_handle, &rendering_info);
 				    };
 
-				    /* Render. */
-				    vkCmdBeginRendering(cmd_buf.m_handle, &rendering_info);
+				    /* Render. Cached static draws need their own rendering, it can only execute secondary command
+				     * buffers. */
+				    const bool cached = m_settings.enable_command_caching;
+				    m_timestamps.reset(cmd_buf);
+				    m_timestamps.write(cmd_buf, 0, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT);
+				    begin_rendering(true, !split && !cached, 0);
 				    {
-					    cmd_buf.bind_pipeline(*m_scene.m_default_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
-					    cmd_buf.set_uniform_buffer(0, m_scene.m_uniform_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+					    /* Opaque depth first, the shading draws then only pass for the nearest fragments. */
+					    if (m_scene.m_depth_prepass)
+					    {
+						    m_scene.draw_depth(cmd_buf);
+					    }
+					    m_timestamps.write(cmd_buf, 1, VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT);
 
-					    for (auto &[e, static_mesh] : m_scene.m_static_mesh_storage)
+					    m_scene.m_geometry_arena.bind_vertex_buffer(cmd_buf);
+					    m_scene.draw(cmd_buf, render_layer_opaque);
+					    if (split)
 					    {
-						    static_mesh->draw(cmd_buf);
+						    vkCmdEndRendering(cmd_buf.m_handle);
+						    m_scene.occlude_static_meshes(cmd_buf, *occlusion_depth->m_texture);
+						    begin_rendering(false, !cached, 0);
+
+						    m_scene.draw_occluded_static_meshes(cmd_buf);
 					    }
-					    for (auto &[e, skybox] : m_scene.m_skybox_storage)
+					    if (cached)
 					    {
-						    if (m_settings.enable_skybox)
-						    {
-							    skybox->draw(cmd_buf);
-						    }
+						    vkCmdEndRendering(cmd_buf.m_handle);
+						    begin_rendering(false, true, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+						    m_scene.draw_cached(cmd_buf,
+						                        { .color_format = m_settings.color_format,
+						                          .depth_format = m_settings.depth_format,
+						                          .sample_count = m_scene.m_sample_count },
+						                        viewport, scissor);
 					    }
-					    if (m_settings.enable_grid)
+					    else
 					    {
-						    /* Draw grid. */
-						    cmd_buf.bind_pipeline(m_scene.m_grid.m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
-						    constexpr VkDeviceSize offset = 0;
-						    vkCmdBindVertexBuffers(cmd_buf.m_handle, 0, 1, &m_scene.m_grid.m_vertex_buffer.m_handle,
-						                           &offset);
-						    cmd_buf.set_uniform_buffer(0, m_scene.m_uniform_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
-						    vkCmdDraw(cmd_buf.m_handle, m_scene.m_grid.m_vertex_count, 1, 0, 0);
-
-						    /* Draw plane. */
-						    cmd_buf.bind_pipeline(m_scene.m_plane.m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
-						    vkCmdBindVertexBuffers(cmd_buf.m_handle, 0, 1, &m_scene.m_plane.m_vertex_buffer.m_handle,
-						                           &offset);
-						    cmd_buf.set_uniform_buffer(0, m_scene.m_uniform_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
-						    vkCmdDraw(cmd_buf.m_handle, 6, 1, 0, 0);
+						    m_scene.draw(cmd_buf, render_layer_sky);
+						    m_scene.draw(cmd_buf, render_layer_transparent);
 					    }
 				    }
 				    vkCmdEndRendering(cmd_buf.m_handle);
+				    m_timestamps.write(cmd_buf, 2, VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT);
 			    });
 		}
 
@@ -223,8 +292,8 @@ void editor::draw()
 					    0.0f, (float)render_height, (float)render_width, -(float)render_height, 0.0f, 1.0f
 				    };
 				    VkRect2D scissor = { { 0.0f, 0.0f }, { render_width, render_height } };
-				    vkCmdSetViewport(cmd_buf.m_handle, 0, 1, &viewport);
-				    vkCmdSetScissor(cmd_buf.m_handle, 0, 1, &scissor);
+				    cmd_buf.set_viewport(viewport);
+				    cmd_buf.set_scissor(scissor);
 
 				    // cmd_buf.transition_image_layout(
 				    //     m_framebuffer.m_color_texture->m_image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
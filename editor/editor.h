@@ -1,5 +1,7 @@
 #pragma once
 
+#include <renderer/vulkan/query_pool.h>
+
 #include "log.h"
 #include "scene.h"
 #include "settings.h"
@@ -15,7 +17,7 @@ class editor
 {
 public:
 	editor() = default;
-	~editor() = default;
+	~editor();
 
 	editor(const editor &) = delete;
 	editor operator=(const editor &) = delete;
@@ -30,6 +32,14 @@ public:
 	ui m_ui = {};
 	console_logger m_logger = {};
 
+	/* GPU time of the main pass, measured the previous frame. */
+	vulkan::timestamp_query_pool m_timestamps = {};
+	struct
+	{
+		float m_depth_prepass_ms = 0.0f;
+		float m_shading_ms = 0.0f;
+	} m_pass_timings = {};
+
 private:
 	void build_default_settings();
 };
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+#include <renderer/vulkan/context.h>
+
+#include "gpu_culling.h"
+#include "object.h"
+#include "scene.h"
+
+static constexpr u32 workgroup_size = 64;
+
+/* Grows buffer to at least size bytes, contents are not preserved. */
+static void reserve_buffer(vulkan::context &context, vulkan::buffer &buffer, VkBufferUsageFlags usage,
+                           VkDeviceSize size)
+{
+	size = std::max(size, (VkDeviceSize)sizeof(u32));
+	if (buffer.m_size < size)
+	{
+		buffer = context.m_resource_allocator.allocate_buffer(usage, std::bit_ceil(size));
+	}
+}
+
+void gpu_culling::build(vulkan::context &context)
+{
+	m_cull_pipeline.add_shader(context.m_device, "bin/assets/shaders/cull_instances.comp.spv");
+	m_cull_pipeline.build(context.m_device);
+	m_compact_pipeline.add_shader(context.m_device, "bin/assets/shaders/compact_draws.comp.spv");
+	m_compact_pipeline.build(context.m_device);
+	m_uniform_buffer =
+	    context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(gpu_culling_constants));
+}
+
+/* Instances of the same model submesh share a material group. */
+static u64 get_group_key(const static_submesh &submesh)
+{
+	return ((u64)submesh.m_mesh->m_model->m_id << 32) | submesh.m_submesh;
+}
+
+void gpu_culling::build_instances(vulkan::context &context, const std::vector<static_submesh> &submeshes)
+{
+	std::unordered_map<u64, u32> group_indices = {};
+	std::vector<u32> group_instance_counts = {};
+	m_groups.clear();
+	for (const static_submesh &submesh : submeshes)
+	{
+		const auto [it, inserted] = group_indices.try_emplace(get_group_key(submesh), (u32)m_groups.size());
+		if (inserted)
+		{
+			m_groups.push_back({ .m_model = submesh.m_mesh->m_model.get(), .m_submesh = submesh.m_submesh });
+			group_instance_counts.push_back(0);
+		}
+		++group_instance_counts[it->second];
+	}
+
+	/* One batch per LOD, each with room for every instance of its group. */
+	std::vector<gpu_batch> batches = {};
+	u32 culled_instance_count = 0;
+	for (u32 g = 0; g < m_groups.size(); ++g)
+	{
+		group &group = m_groups[g];
+		const static_model::submesh &submesh = group.m_model->m_submeshes[group.m_submesh];
+		group.m_first_draw = batches.size();
+		group.m_draw_count = submesh.m_lods.size();
+		for (const assets::mesh_lod &lod : submesh.m_lods)
+		{
+			batches.push_back({ .index_count = lod.index_count,
+			                    .instance_count = 0,
+			                    .first_index = lod.first_index,
+			                    .vertex_offset = submesh.m_geometry.vertex_offset,
+			                    .first_instance = culled_instance_count,
+			                    .group = g,
+			                    .group_first_draw = group.m_first_draw,
+			                    .drawn_count = 0,
+			                    .error = lod.error,
+			                    .pad = {} });
+			culled_instance_count += group_instance_counts[g];
+		}
+	}
+
+	m_instances.resize(submeshes.size());
+	for (u32 i = 0; i < submeshes.size(); ++i)
+	{
+		const group &group = m_groups[group_indices.at(get_group_key(submeshes[i]))];
+		m_instances[i] = { .model = submeshes[i].m_mesh->get_submesh_transform(submeshes[i].m_submesh),
+			               .sphere = submeshes[i].m_mesh->get_submesh_bounding_sphere(submeshes[i].m_submesh),
+			               .first_batch = group.m_first_draw,
+			               .lod_count = group.m_draw_count,
+			               .pad = {} };
+	}
+
+	/* The previous frame has finished by the time we update, host-visible buffers are rewritten in place. */
+	reserve_buffer(context, m_instance_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	               m_instances.size() * sizeof(gpu_instance));
+	reserve_buffer(context, m_batch_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batches.size() * sizeof(gpu_batch));
+	reserve_buffer(context, m_culled_instance_buffer,
+	               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	               culled_instance_count * sizeof(instance_data));
+	reserve_buffer(context, m_occluded_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_instances.size() * sizeof(u32));
+	reserve_buffer(context, m_draw_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+	               phase_count * batches.size() * sizeof(VkDrawIndexedIndirectCommand));
+	reserve_buffer(context, m_draw_count_buffer,
+	               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+	                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	               phase_count * m_groups.size() * sizeof(u32));
+
+	if (!m_instances.empty())
+	{
+		m_instance_buffer.fill(m_instances.data(), m_instances.size() * sizeof(gpu_instance));
+	}
+	if (!batches.empty())
+	{
+		m_batch_buffer.fill(batches.data(), batches.size() * sizeof(gpu_batch));
+	}
+
+	m_constants.instance_count = m_instances.size();
+	m_constants.batch_count = batches.size();
+	m_constants.group_count = m_groups.size();
+}
+
+void gpu_culling::update_instance(u32 instance, const static_submesh &submesh)
+{
+	m_instances[instance].model = submesh.m_mesh->get_submesh_transform(submesh.m_submesh);
+	m_instances[instance].sphere = submesh.m_mesh->get_submesh_bounding_sphere(submesh.m_submesh);
+	m_instance_buffer.fill(&m_instances[instance], sizeof(gpu_instance), instance * sizeof(gpu_instance));
+}
+
+void gpu_culling::update(const glm::vec4 planes[6], const glm::mat4 &view_projection,
+                         const glm::vec3 &camera_position, const gpu_lod_selection &lod,
+                         const depth_pyramid &depth_pyramid, bool occlusion)
+{
+	for (u32 p = 0; p < 6; ++p)
+	{
+		m_constants.planes[p] = planes[p];
+	}
+	/* The pyramid only holds last frame's depth if it was generated with last frame's view. */
+	m_constants.previous_view_projection = m_constants.view_projection;
+	m_constants.view_projection = view_projection;
+	m_constants.pyramid_width = depth_pyramid.m_width;
+	m_constants.pyramid_height = depth_pyramid.m_height;
+	m_constants.pyramid_levels = depth_pyramid.get_level_count();
+	m_constants.previous_occlusion = occlusion && m_constants.occlusion && depth_pyramid.m_valid;
+	m_constants.occlusion = occlusion;
+	m_constants.camera_position = glm::vec4(camera_position, 1.0f);
+	m_constants.projection_scale = lod.projection_scale;
+	m_constants.lod_error_threshold = lod.error_threshold;
+	m_constants.lod = lod.enable;
+	m_uniform_buffer.fill(&m_constants, sizeof(m_constants));
+}
+
+void gpu_culling::cull(vulkan::command_buffer &command_buffer, const depth_pyramid &depth_pyramid, u32 phase)
+{
+	if (0 == m_constants.instance_count)
+	{
+		return;
+	}
+
+	/* Batch counts were restarted by last frame's compact pass, draw counts of both phases start from zero. */
+	if (0 == phase)
+	{
+		command_buffer.memory_barrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+		                              VK_ACCESS_2_SHADER_WRITE_BIT,
+		                              VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		                              VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT |
+		                                  VK_ACCESS_2_SHADER_WRITE_BIT);
+		vkCmdFillBuffer(command_buffer.m_handle, m_draw_count_buffer.m_handle, 0,
+		                phase_count * m_groups.size() * sizeof(u32), 0);
+		command_buffer.memory_barrier(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		                              VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+	}
+
+	/* Cull instances into the batch ranges of their LOD. */
+	command_buffer.bind_pipeline(m_cull_pipeline);
+	command_buffer.set_storage_buffer(0, m_instance_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_storage_buffer(1, m_batch_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_storage_buffer(2, m_culled_instance_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_storage_buffer(3, m_occluded_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_uniform_buffer(4, m_uniform_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_sampled_image(5, *depth_pyramid.m_image_view, depth_pyramid.m_sampler,
+	                                 VK_PIPELINE_BIND_POINT_COMPUTE);
+	vkCmdPushConstants(command_buffer.m_handle, m_cull_pipeline.m_pipeline_layout.m_handle,
+	                   VK_SHADER_STAGE_COMPUTE_BIT, /* offset = */ 0, sizeof(phase), &phase);
+	command_buffer.dispatch((m_constants.instance_count + workgroup_size - 1) / workgroup_size, 1, 1);
+	command_buffer.memory_barrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+	                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+
+	/* Compact non-empty batches into indirect draws. */
+	command_buffer.bind_pipeline(m_compact_pipeline);
+	command_buffer.set_storage_buffer(0, m_batch_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_storage_buffer(1, m_draw_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_storage_buffer(2, m_draw_count_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	command_buffer.set_uniform_buffer(3, m_uniform_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	vkCmdPushConstants(command_buffer.m_handle, m_compact_pipeline.m_pipeline_layout.m_handle,
+	                   VK_SHADER_STAGE_COMPUTE_BIT, /* offset = */ 0, sizeof(phase), &phase);
+	command_buffer.dispatch((m_constants.batch_count + workgroup_size - 1) / workgroup_size, 1, 1);
+	command_buffer.memory_barrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+	                              VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+	                              VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void gpu_culling::draw(vulkan::command_buffer &command_buffer, u32 phase, bool depth_only)
+{
+	if (0 == m_constants.instance_count)
+	{
+		return;
+	}
+
+	command_buffer.bind_vertex_buffer(static_model::instance_binding, m_culled_instance_buffer, 0);
+	for (u32 g = 0; g < m_groups.size(); ++g)
+	{
+		const group &group = m_groups[g];
+		const u32 first_draw = phase * m_constants.batch_count + group.m_first_draw;
+		const u32 draw_count = phase * m_constants.group_count + g;
+		group.m_model->bind(command_buffer, group.m_submesh, depth_only);
+		vkCmdDrawIndexedIndirectCount(command_buffer.m_handle, m_draw_buffer.m_handle,
+		                              first_draw * sizeof(VkDrawIndexedIndirectCommand), m_draw_count_buffer.m_handle,
+		                              draw_count * sizeof(u32), group.m_draw_count,
+		                              sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
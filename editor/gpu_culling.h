@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <glm/glm.hpp>
+#pragma clang diagnostic pop
+
+#include <renderer/vulkan/buffer.h>
+#include <renderer/vulkan/command_buffer.h>
+#include <renderer/vulkan/pipeline.h>
+
+#include "depth_pyramid.h"
+
+class static_model;
+struct static_submesh;
+
+namespace vulkan
+{
+class context;
+}
+
+/* Instance input of the culling shader, see cull_instances.comp. */
+struct gpu_instance
+{
+	glm::mat4 model;
+	glm::vec4 sphere;
+	u32 first_batch; /* Batch of the first LOD, the other LODs follow. */
+	u32 lod_count;
+	u32 pad[2];
+};
+static_assert(sizeof(gpu_instance) == 96, "Unexpected gpu_instance size");
+
+/* One LOD of a static model submesh, laid out as VkDrawIndexedIndirectCommand followed by its material group. The
+ * culling shaders count instances into it, the counts restart after the last phase of each frame. */
+struct gpu_batch
+{
+	u32 index_count;
+	u32 instance_count;
+	u32 first_index;
+	i32 vertex_offset;
+	u32 first_instance;
+	u32 group;
+	u32 group_first_draw;
+	u32 drawn_count;
+	float error;
+	u32 pad[3];
+};
+static_assert(sizeof(gpu_batch) == 48, "Unexpected gpu_batch size");
+
+/* Uniforms shared by the culling shaders, std140. */
+struct gpu_culling_constants
+{
+	glm::vec4 planes[6];
+	glm::mat4 view_projection;
+	glm::mat4 previous_view_projection;
+	u32 pyramid_width;
+	u32 pyramid_height;
+	u32 pyramid_levels;
+	u32 instance_count;
+	u32 batch_count;
+	u32 group_count;
+	u32 occlusion;
+	u32 previous_occlusion;
+	glm::vec4 camera_position;
+	float projection_scale;
+	float lod_error_threshold;
+	u32 lod;
+	u32 pad;
+};
+static_assert(sizeof(gpu_culling_constants) == 288, "Unexpected gpu_culling_constants size");
+
+/* LOD selection of the culling shader, see static_mesh::select_lod. */
+struct gpu_lod_selection
+{
+	bool enable;
+	float projection_scale;
+	float error_threshold;
+};
+
+/* GPU-driven static mesh submission. A compute pass frustum culls instances and selects their LOD into per-batch
+ * ranges of a compacted instance buffer, a second pass appends non-empty batches to the draw range of their material
+ * group. Each group is then drawn with a single vkCmdDrawIndexedIndirectCount.
+ *
+ * Instances and batches persist on the GPU. They are rebuilt when static meshes are added or removed, and moved
+ * instances are written individually.
+ *
+ * With occlusion culling, the first phase also tests instances against the previous frame's depth pyramid and
+ * draws the survivors. The pyramid is then rebuilt from that depth, and the second phase re-tests the instances
+ * that were occluded so that newly visible ones are drawn in the same frame. */
+class gpu_culling
+{
+public:
+	gpu_culling() = default;
+	~gpu_culling() = default;
+
+	gpu_culling(const gpu_culling &) = delete;
+	gpu_culling operator=(const gpu_culling &) = delete;
+
+	void build(vulkan::context &context);
+
+	/* Rebuilds instances and batches, instance i is submeshes[i]. */
+	void build_instances(vulkan::context &context, const std::vector<static_submesh> &submeshes);
+	void update_instance(u32 instance, const static_submesh &submesh);
+
+	void update(const glm::vec4 planes[6], const glm::mat4 &view_projection, const glm::vec3 &camera_position,
+	            const gpu_lod_selection &lod, const depth_pyramid &depth_pyramid, bool occlusion);
+	void cull(vulkan::command_buffer &command_buffer, const depth_pyramid &depth_pyramid, u32 phase);
+	void draw(vulkan::command_buffer &command_buffer, u32 phase, bool depth_only = false);
+
+	static constexpr u32 phase_count = 2;
+
+private:
+	struct group
+	{
+		static_model *m_model = nullptr;
+		u32 m_submesh = 0;
+		u32 m_first_draw = 0;
+		u32 m_draw_count = 0;
+	};
+
+	vulkan::compute_pipeline m_cull_pipeline = {};
+	vulkan::compute_pipeline m_compact_pipeline = {};
+
+	vulkan::buffer m_uniform_buffer = {};
+	vulkan::buffer m_instance_buffer = {};
+	vulkan::buffer m_batch_buffer = {};
+	vulkan::buffer m_culled_instance_buffer = {};
+	vulkan::buffer m_occluded_buffer = {};
+	vulkan::buffer m_draw_buffer = {};
+	vulkan::buffer m_draw_count_buffer = {};
+
+	std::vector<group> m_groups = {};
+	std::vector<gpu_instance> m_instances = {};
+	gpu_culling_constants m_constants = {};
+};
@@ -6,7 +6,7 @@
 #include "log.h"
 #include "object.h"
 
-void skybox::build(vulkan::context &context)
+void skybox::build(vulkan::context &context, const vulkan::descriptor_set &pass_set)
 {
 	/* Load image to get dimensions. */
 	m_asset_image.load("bin/assets/images/skybox/right.jpg");
@@ -32,6 +32,9 @@ void skybox::build(vulkan::context &context)
 	m_asset_image.load("bin/assets/images/skybox/back.jpg");
 	m_texture.m_image.fill_layer(context, m_asset_image.m_data.data(), m_asset_image.m_data.size(), 5);
 	m_texture.m_image.transition_layout(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	m_texture_index = context.m_bindless_table.add_texture(m_texture);
+	m_bindless_table = &context.m_bindless_table;
+	m_pass_set = &pass_set;
 
 	/* Pipeline. */
 	m_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_VERTEX_BIT, "bin/assets/shaders/skybox.vert.spv");
@@ -44,83 +47,351 @@ void skybox::build(vulkan::context &context)
 
 void skybox::draw(vulkan::command_buffer &command_buffer)
 {
-	/* (TODO, thoave01): Fix stage flags. */
 	vkCmdPushConstants(command_buffer.m_handle, m_pipeline.m_pipeline_layout.m_handle,
-	                   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, /* offset = */ 0,
-	                   m_pipeline.m_pipeline_layout.m_push_constants_size, &m_uniforms);
+	                   m_pipeline.m_pipeline_layout.m_push_constants_stages, /* offset = */ 0, sizeof(m_uniforms),
+	                   &m_uniforms);
+	vkCmdPushConstants(command_buffer.m_handle, m_pipeline.m_pipeline_layout.m_handle,
+	                   m_pipeline.m_pipeline_layout.m_push_constants_stages, /* offset = */ sizeof(m_uniforms),
+	                   sizeof(m_texture_index), &m_texture_index);
 
 	command_buffer.bind_pipeline(m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
-	command_buffer.set_texture(1, m_texture, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_bindless_table->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_pass_set->bind(command_buffer, vulkan::descriptor_set_pass, VK_PIPELINE_BIND_POINT_GRAPHICS);
 	vkCmdDraw(command_buffer.m_handle, 36, 1, /* firstVertex = */ 0, /* firstInstance = */ 0);
 }
 
-void skybox::update_material(VkSampleCountFlagBits sample_count)
+void skybox::update_material(VkSampleCountFlagBits sample_count, bool defer_compile)
 {
 	m_pipeline.set_sample_count(sample_count);
-	m_pipeline.update();
+	if (defer_compile)
+	{
+		m_pipeline.defer_update();
+	}
+	else
+	{
+		m_pipeline.update();
+	}
+}
+
+void skybox::flush_material()
+{
+	m_pipeline.flush_deferred_update();
 }
 
-void static_mesh::build(vulkan::context &context, ref<assets::model> model)
+void static_model::build(vulkan::context &context, geometry_arena &geometry_arena,
+                         const vulkan::descriptor_set &pass_set, ref<assets::model> model)
 {
 	m_model = model;
+	m_geometry_arena = &geometry_arena;
+	m_bindless_table = &context.m_bindless_table;
+	m_pass_set = &pass_set;
+
+	m_submeshes.clear();
+	m_submeshes.reserve(m_model->m_meshes.size());
+	for (const assets::mesh &mesh : m_model->m_meshes)
+	{
+		submesh &submesh = m_submeshes.emplace_back();
+
+		/* Geometry, 16-bit indices if the optimizer found the mesh small enough. */
+		const std::vector<packed_vertex> packed_vertices = assets::pack_vertices(mesh.m_vertices);
+		const std::vector<packed_position> packed_positions = assets::pack_positions(mesh.m_vertices);
+		if (!mesh.m_short_indices.empty())
+		{
+			submesh.m_geometry = geometry_arena.allocate(packed_vertices.data(), packed_positions.data(),
+			                                             packed_vertices.size(), mesh.m_short_indices.data(),
+			                                             mesh.m_short_indices.size(), VK_INDEX_TYPE_UINT16);
+		}
+		else
+		{
+			submesh.m_geometry = geometry_arena.allocate(packed_vertices.data(), packed_positions.data(),
+			                                             packed_vertices.size(), mesh.m_indices.data(),
+			                                             mesh.m_indices.size(), VK_INDEX_TYPE_UINT32);
+		}
+
+		/* LODs share the index range, meshes without any get a single LOD covering all indices. */
+		submesh.m_lods = mesh.m_lods;
+		if (submesh.m_lods.empty())
+		{
+			submesh.m_lods.push_back({ .first_index = 0, .index_count = (u32)mesh.m_indices.size(), .error = 0.0f });
+		}
+		for (assets::mesh_lod &lod : submesh.m_lods)
+		{
+			lod.first_index += submesh.m_geometry.first_index;
+		}
 
-	/* Vertex buffer. */
-	m_vertex_buffer = context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	                                                               sizeof(m_model->m_meshes[0].m_vertices[0]) *
-	                                                                   m_model->m_meshes[0].m_vertices.size());
-	m_vertex_buffer.fill(m_model->m_meshes[0].m_vertices.data(),
-	                     sizeof(m_model->m_meshes[0].m_vertices[0]) * m_model->m_meshes[0].m_vertices.size());
-
-	/* Index buffer. */
-	m_index_buffer = context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-	                                                              sizeof(m_model->m_meshes[0].m_indices[0]) *
-	                                                                  m_model->m_meshes[0].m_indices.size());
-	m_index_buffer.fill(m_model->m_meshes[0].m_indices.data(),
-	                    sizeof(m_model->m_meshes[0].m_indices[0]) * m_model->m_meshes[0].m_indices.size());
-	m_index_count = m_model->m_meshes[0].m_indices.size();
-
-	/* Diffuse texture. */
-	m_diffuse_texture.build(context, { .m_format = VK_FORMAT_R8G8B8A8_SRGB,
-	                                   .m_width = (u32)m_model->m_meshes[0].m_width,
-	                                   .m_height = (u32)m_model->m_meshes[0].m_height,
-	                                   .m_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-	                                              VK_IMAGE_USAGE_SAMPLED_BIT,
-	                                   .m_mipmapped = true });
-	m_diffuse_texture.m_image.fill(context, m_model->m_meshes[0].m_texture.data(),
-	                               m_model->m_meshes[0].m_texture.size());
-	m_diffuse_texture.m_image.generate_mipmaps(context);
-	m_diffuse_texture.m_image.transition_layout(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		/* Diffuse texture, white if the mesh has none. */
+		if (!mesh.m_texture.empty())
+		{
+			submesh.m_diffuse_texture->build(context, { .m_format = VK_FORMAT_R8G8B8A8_SRGB,
+			                                            .m_width = (u32)mesh.m_width,
+			                                            .m_height = (u32)mesh.m_height,
+			                                            .m_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+			                                                       VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+			                                                       VK_IMAGE_USAGE_SAMPLED_BIT,
+			                                            .m_mipmapped = true });
+			submesh.m_diffuse_texture->m_image.fill(context, mesh.m_texture.data(), mesh.m_texture.size());
+			submesh.m_diffuse_texture->m_image.generate_mipmaps(context);
+		}
+		else
+		{
+			constexpr u8 white[4] = { 0xff, 0xff, 0xff, 0xff };
+			submesh.m_diffuse_texture->build(context, { .m_format = VK_FORMAT_R8G8B8A8_SRGB,
+			                                            .m_width = 1,
+			                                            .m_height = 1,
+			                                            .m_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+			                                                       VK_IMAGE_USAGE_SAMPLED_BIT });
+			submesh.m_diffuse_texture->m_image.fill(context, white, sizeof(white));
+		}
+		submesh.m_diffuse_texture->m_image.transition_layout(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		submesh.m_diffuse_texture_index = context.m_bindless_table.add_texture(*submesh.m_diffuse_texture);
+
+		/* Material set, written once and bound per submesh. */
+		const material_uniforms material = { .diffuse_texture = submesh.m_diffuse_texture_index };
+		submesh.m_material_buffer =
+		    context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(material));
+		submesh.m_material_buffer.fill(&material, sizeof(material));
+		submesh.m_material_set->add_binding(material_uniform_binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		submesh.m_material_set->build(context.m_device);
+		submesh.m_material_set->write_uniform_buffer(material_uniform_binding, submesh.m_material_buffer);
+
+		submesh.m_transform = mesh.m_transform;
+		submesh.m_bounds = mesh.m_bounds;
+	}
 
 	/* Pipeline. */
 	m_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_VERTEX_BIT, "bin/assets/shaders/basic.vert.spv");
 	m_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_FRAGMENT_BIT, "bin/assets/shaders/basic.frag.spv");
+	m_pipeline.set_vertex_attribute_format(0, VK_FORMAT_R16G16B16A16_SFLOAT);
+	m_pipeline.set_vertex_attribute_format(1, VK_FORMAT_R16G16_SFLOAT);
+	m_pipeline.set_vertex_attribute_format(2, VK_FORMAT_R8G8B8A8_UNORM);
+	for (u32 location = 3; location < 7; ++location)
+	{
+		m_pipeline.set_vertex_attribute_binding(location, instance_binding);
+	}
+	m_pipeline.set_vertex_binding_input_rate(instance_binding, VK_VERTEX_INPUT_RATE_INSTANCE);
 	m_pipeline.build(context.m_device);
 
-	/* Uniforms. */
-	m_uniforms.model = m_model->m_meshes[0].m_transform;
+	/* Depth-only pipeline, reads the position stream of the geometry arena. */
+	m_depth_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_VERTEX_BIT, "bin/assets/shaders/depth.vert.spv");
+	m_depth_pipeline.set_vertex_attribute_format(0, VK_FORMAT_R16G16B16A16_SFLOAT);
+	for (u32 location = 1; location < 5; ++location)
+	{
+		m_depth_pipeline.set_vertex_attribute_binding(location, instance_binding);
+	}
+	m_depth_pipeline.set_vertex_binding_input_rate(instance_binding, VK_VERTEX_INPUT_RATE_INSTANCE);
+	m_depth_pipeline.set_color_write_mask(0);
+	m_depth_pipeline.build(context.m_device);
+
+	/* Mesh shading pipeline, optional. */
+	if (context.m_device.m_features.m_mesh_shader)
+	{
+		build_meshlets(context);
+	}
 }
 
-void static_mesh::draw(vulkan::command_buffer &command_buffer)
+void static_model::build_meshlets(vulkan::context &context)
 {
-	/* (TODO, thoave01): Fix stage flags. */
-	vkCmdPushConstants(command_buffer.m_handle, m_pipeline.m_pipeline_layout.m_handle,
-	                   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, /* offset = */ 0,
-	                   m_pipeline.m_pipeline_layout.m_push_constants_size, &m_uniforms);
+	/* Concatenate the meshlets of all submeshes, rebasing their ranges and vertices. */
+	std::vector<assets::meshlet> meshlets = {};
+	std::vector<u32> meshlet_vertices = {};
+	std::vector<u32> meshlet_triangles = {};
+	for (u32 s = 0; s < m_submeshes.size(); ++s)
+	{
+		const assets::mesh &mesh = m_model->m_meshes[s];
+		submesh &submesh = m_submeshes[s];
+		submesh.m_first_meshlet = meshlets.size();
+		submesh.m_meshlet_count = mesh.m_meshlets.size();
+		for (assets::meshlet meshlet : mesh.m_meshlets)
+		{
+			meshlet.vertex_offset += meshlet_vertices.size();
+			meshlet.triangle_offset += meshlet_triangles.size();
+			meshlets.push_back(meshlet);
+		}
+		for (u32 v : mesh.m_meshlet_vertices)
+		{
+			meshlet_vertices.push_back(v + submesh.m_geometry.vertex_offset);
+		}
+		meshlet_triangles.insert(meshlet_triangles.end(), mesh.m_meshlet_triangles.begin(),
+		                         mesh.m_meshlet_triangles.end());
+	}
 
-	command_buffer.bind_pipeline(m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
-	constexpr VkDeviceSize offset = 0;
-	vkCmdBindVertexBuffers(command_buffer.m_handle, 0, 1, &m_vertex_buffer.m_handle, &offset);
-	vkCmdBindIndexBuffer(command_buffer.m_handle, m_index_buffer.m_handle, 0, VK_INDEX_TYPE_UINT32);
-	command_buffer.set_texture(1, m_diffuse_texture, VK_PIPELINE_BIND_POINT_GRAPHICS);
-	vkCmdDrawIndexed(command_buffer.m_handle, m_index_count,
-	                 /* instanceCount = */ 1, /* firstIndex = */ 0, /* vertexOffset = */ 0,
-	                 /* firstInstance = */ 0);
+	const auto upload = [&](vulkan::buffer &buffer, const void *data, VkDeviceSize size)
+	{
+		/* Empty buffers can not be created, keep one element. */
+		buffer = context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                                                      std::max(size, (VkDeviceSize)sizeof(assets::meshlet)));
+		if (size > 0)
+		{
+			buffer.fill(data, size);
+		}
+	};
+	upload(m_meshlet_buffer, meshlets.data(), meshlets.size() * sizeof(assets::meshlet));
+	upload(m_meshlet_vertex_buffer, meshlet_vertices.data(), meshlet_vertices.size() * sizeof(u32));
+	upload(m_meshlet_triangle_buffer, meshlet_triangles.data(), meshlet_triangles.size() * sizeof(u32));
+
+	m_mesh_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_TASK_BIT_EXT, "bin/assets/shaders/meshlet.task.spv");
+	m_mesh_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_MESH_BIT_EXT, "bin/assets/shaders/meshlet.mesh.spv");
+	m_mesh_pipeline.add_shader(context.m_device, VK_SHADER_STAGE_FRAGMENT_BIT, "bin/assets/shaders/basic.frag.spv");
+	m_mesh_pipeline.build(context.m_device);
 }
 
-void static_mesh::update_material(VkSampleCountFlagBits sample_count)
+void static_model::update_material(VkSampleCountFlagBits sample_count, bool depth_prepass, bool mipmapping,
+                                   bool defer_compile)
 {
+	/* After a depth pre-pass only the nearest fragments are shaded, and depth is already written. */
 	m_pipeline.set_sample_count(sample_count);
-	m_pipeline.update();
+	m_pipeline.set_depth_compare_op(depth_prepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL);
+	m_pipeline.set_depth_write_enable(depth_prepass ? VK_FALSE : VK_TRUE);
+	m_pipeline.set_specialization_constant(enable_mipmapping_constant, mipmapping);
+	m_depth_pipeline.set_sample_count(sample_count);
+	if (defer_compile)
+	{
+		m_pipeline.defer_update();
+		m_depth_pipeline.defer_update();
+	}
+	else
+	{
+		m_pipeline.update();
+		m_depth_pipeline.update();
+	}
+
+	/* The mesh shading path never runs after a depth pre-pass, and is always bound as a VkPipeline. */
+	if (VK_NULL_HANDLE != m_mesh_pipeline.m_handle)
+	{
+		m_mesh_pipeline.set_sample_count(sample_count);
+		m_mesh_pipeline.set_specialization_constant(enable_mipmapping_constant, mipmapping);
+		m_mesh_pipeline.update();
+	}
+}
+
+void static_model::flush_material()
+{
+	m_pipeline.flush_deferred_update();
+	m_depth_pipeline.flush_deferred_update();
+}
+
+void static_mesh::build(ref<static_model> model)
+{
+	m_model = model;
+	m_lods.assign(m_model->m_submeshes.size(), 0);
+	m_uniforms.model = glm::mat4(1.0f);
+	update_bounds();
+}
+
+void static_model::bind(vulkan::command_buffer &command_buffer, u32 submesh, bool depth_only)
+{
+	/* Geometry arena vertices or positions are bound by the caller. */
+	if (depth_only)
+	{
+		command_buffer.bind_pipeline(m_depth_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+		m_pass_set->bind(command_buffer, vulkan::descriptor_set_pass, VK_PIPELINE_BIND_POINT_GRAPHICS);
+		m_geometry_arena->bind_index_buffer(command_buffer, m_submeshes[submesh].m_geometry.index_type);
+		return;
+	}
+
+	command_buffer.bind_pipeline(m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_bindless_table->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_pass_set->bind(command_buffer, vulkan::descriptor_set_pass, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_submeshes[submesh].m_material_set->bind(command_buffer, vulkan::descriptor_set_material,
+	                                          VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_geometry_arena->bind_index_buffer(command_buffer, m_submeshes[submesh].m_geometry.index_type);
+}
+
+void static_model::draw(vulkan::command_buffer &command_buffer, u32 submesh, u32 lod, u32 first_instance,
+                        u32 instance_count, bool depth_only)
+{
+	const assets::mesh_lod &mesh_lod = m_submeshes[submesh].m_lods[lod];
+	bind(command_buffer, submesh, depth_only);
+	vkCmdDrawIndexed(command_buffer.m_handle, mesh_lod.index_count, instance_count, mesh_lod.first_index,
+	                 m_submeshes[submesh].m_geometry.vertex_offset, first_instance);
+}
+
+void static_model::bind_meshlets(vulkan::command_buffer &command_buffer)
+{
+	command_buffer.bind_pipeline(m_mesh_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_bindless_table->bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	m_pass_set->bind(command_buffer, vulkan::descriptor_set_pass, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	command_buffer.set_storage_buffer(meshlet_arena_vertex_binding, m_geometry_arena->m_vertex_buffer,
+	                                  VK_PIPELINE_BIND_POINT_GRAPHICS);
+	command_buffer.set_storage_buffer(meshlet_binding, m_meshlet_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	command_buffer.set_storage_buffer(meshlet_vertex_binding, m_meshlet_vertex_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	command_buffer.set_storage_buffer(meshlet_triangle_binding, m_meshlet_triangle_buffer,
+	                                  VK_PIPELINE_BIND_POINT_GRAPHICS);
+}
+
+void static_model::draw_meshlets(vulkan::command_buffer &command_buffer, u32 submesh, u32 first_instance,
+                                 u32 instance_count)
+{
+	/* One task workgroup per 32 meshlets and instance, see meshlet.task. */
+	constexpr u32 task_workgroup_size = 32;
+	m_submeshes[submesh].m_material_set->bind(command_buffer, vulkan::descriptor_set_material,
+	                                          VK_PIPELINE_BIND_POINT_GRAPHICS);
+	const meshlet_constants constants = { .first_meshlet = m_submeshes[submesh].m_first_meshlet,
+		                                  .meshlet_count = m_submeshes[submesh].m_meshlet_count,
+		                                  .first_instance = first_instance };
+	vkCmdPushConstants(command_buffer.m_handle, m_mesh_pipeline.m_pipeline_layout.m_handle,
+	                   m_mesh_pipeline.m_pipeline_layout.m_push_constants_stages, /* offset = */ 0, sizeof(constants),
+	                   &constants);
+	const u32 group_count = (constants.meshlet_count + task_workgroup_size - 1) / task_workgroup_size;
+	vkCmdDrawMeshTasksEXT(command_buffer.m_handle, group_count, instance_count, 1);
+}
+
+glm::mat4 static_mesh::get_submesh_transform(u32 submesh) const
+{
+	return m_uniforms.model * m_model->m_submeshes[submesh].m_transform;
+}
+
+glm::vec4 static_mesh::get_submesh_bounding_sphere(u32 submesh) const
+{
+	return m_bounds[submesh].sphere;
+}
+
+void static_mesh::update_bounds()
+{
+	m_bounds.resize(m_model->m_submeshes.size());
+	for (u32 s = 0; s < m_model->m_submeshes.size(); ++s)
+	{
+		const glm::mat4 model = get_submesh_transform(s);
+		const assets::mesh_bounds &bounds = m_model->m_submeshes[s].m_bounds;
+
+		/* Transformed box center, extent projected onto the world axes through the absolute rotation/scale. */
+		const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+		const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+		m_bounds[s].center = glm::vec3(model * glm::vec4(center, 1.0f));
+		m_bounds[s].extent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y +
+		                     glm::abs(glm::vec3(model[2])) * extent.z;
+
+		const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+		                               glm::length(glm::vec3(model[2])) });
+		m_bounds[s].sphere = glm::vec4(glm::vec3(model * glm::vec4(bounds.center, 1.0f)), bounds.radius * scale);
+	}
+	m_moved = true;
+}
+
+void static_mesh::select_lod(const camera &camera, float viewport_height, float error_threshold)
+{
+	for (u32 s = 0; s < m_model->m_submeshes.size(); ++s)
+	{
+		/* LOD errors are in model space, scale them by the largest axis of the submesh transform. */
+		const std::vector<assets::mesh_lod> &lods = m_model->m_submeshes[s].m_lods;
+		const glm::mat4 model = get_submesh_transform(s);
+		const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+		                               glm::length(glm::vec3(model[2])) });
+		/* Distance to the nearest point of the bounding sphere, the full LOD is kept from inside it. */
+		const glm::vec4 sphere = m_bounds[s].sphere;
+		const float distance = std::max(glm::length(camera.get_position() - glm::vec3(sphere)) - sphere.w, 1e-3f);
+		const float pixels_per_unit = camera.get_projection_scale(viewport_height) * scale / distance;
+
+		m_lods[s] = 0;
+		for (u32 lod = 1; lod < lods.size(); ++lod)
+		{
+			if (lods[lod].error * pixels_per_unit > error_threshold)
+			{
+				break;
+			}
+			m_lods[s] = lod;
+		}
+	}
 }
 
 void camera::build(glm::vec3 position, glm::vec3 target)
@@ -205,3 +476,38 @@ void camera::update(float aspect_ratio)
 void camera::draw(vulkan::command_buffer &command_buffer)
 {
 }
+
+glm::vec3 camera::get_position() const
+{
+	return m_position;
+}
+
+float camera::get_far_plane() const
+{
+	return m_far;
+}
+
+void camera::get_frustum_planes(glm::vec4 planes[6]) const
+{
+	/* Gribb/Hartmann, for a [0, 1] depth range the near plane is the third row alone. */
+	const glm::mat4 m = m_projection * m_view;
+	const glm::vec4 row0 = { m[0][0], m[1][0], m[2][0], m[3][0] };
+	const glm::vec4 row1 = { m[0][1], m[1][1], m[2][1], m[3][1] };
+	const glm::vec4 row2 = { m[0][2], m[1][2], m[2][2], m[3][2] };
+	const glm::vec4 row3 = { m[0][3], m[1][3], m[2][3], m[3][3] };
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row2;
+	planes[5] = row3 - row2;
+	for (u32 p = 0; p < 6; ++p)
+	{
+		planes[p] /= glm::length(glm::vec3(planes[p]));
+	}
+}
+
+float camera::get_projection_scale(float viewport_height) const
+{
+	return viewport_height / (2.0f * tanf(m_fov * 0.5f));
+}
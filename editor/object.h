@@ -8,8 +8,10 @@
 
 #include <assets/image.h>
 #include <assets/model.h>
+#include <renderer/geometry_arena.h>
 #include <renderer/vulkan/buffer.h>
 #include <renderer/vulkan/command_buffer.h>
+#include <renderer/vulkan/descriptor_set.h>
 
 struct object_uniforms
 {
@@ -17,6 +19,36 @@ struct object_uniforms
 };
 static_assert(sizeof(object_uniforms) == 4 * 4 * 4, "Unexpected object struct uniform size");
 
+/* Uniforms of a static model submesh, in its material set. */
+struct material_uniforms
+{
+	u32 diffuse_texture; /* Index in the bindless table. */
+};
+
+/* Per-draw push constants of the static model mesh shading path. */
+struct meshlet_constants
+{
+	u32 first_meshlet;
+	u32 meshlet_count;
+	u32 first_instance;
+};
+
+/* Per-frame task shader culling data, in world space. */
+struct meshlet_culling_uniforms
+{
+	glm::vec4 planes[6];
+	glm::vec4 camera_position;
+};
+
+/* Per-instance vertex data of static meshes. */
+struct instance_data
+{
+	glm::mat4 model;
+};
+static_assert(sizeof(instance_data) == 4 * 4 * 4, "Unexpected instance struct size");
+
+class camera;
+
 class object
 {
 public:
@@ -33,19 +65,101 @@ public:
 	skybox(const skybox &) = delete;
 	skybox operator=(const skybox &) = delete;
 
-	void build(vulkan::context &context);
+	/* The pass set holds the scene uniforms, see scene::m_pass_set. */
+	void build(vulkan::context &context, const vulkan::descriptor_set &pass_set);
 	void draw(vulkan::command_buffer &command_buffer) override;
-	void update_material(VkSampleCountFlagBits sample_count);
+
+	/* With defer_compile, pipeline compiles wait for flush_material while shader objects are in use. */
+	void update_material(VkSampleCountFlagBits sample_count, bool defer_compile);
+	void flush_material();
 
 	assets::image m_asset_image = {};
 	vulkan::texture m_texture = {};
+	u32 m_texture_index = 0; /* Index in the bindless table. */
 	vulkan::pipeline m_pipeline = {};
 	object_uniforms m_uniforms = {};
 
 private:
+	const vulkan::bindless_table *m_bindless_table = nullptr;
+	const vulkan::descriptor_set *m_pass_set = nullptr;
 };
 
-class static_mesh : public object
+/* GPU side of an assets::model, shared by all static meshes placing it in the scene. */
+class static_model
+{
+public:
+	static_model() = default;
+	~static_model() = default;
+
+	static_model(const static_model &) = delete;
+	static_model operator=(const static_model &) = delete;
+
+	/* The pass set holds the scene uniforms, see scene::m_pass_set. */
+	void build(vulkan::context &context, geometry_arena &geometry_arena, const vulkan::descriptor_set &pass_set,
+	           ref<assets::model> model);
+	/* With defer_compile, pipeline compiles wait for flush_material while shader objects are in use. */
+	void update_material(VkSampleCountFlagBits sample_count, bool depth_prepass, bool mipmapping, bool defer_compile);
+	void flush_material();
+
+	/* Binds pipeline, bindless textures, scene uniforms, index buffer and material set of a submesh. Depth-only binds
+	 * use the depth pipeline and expect the arena positions instead of vertices. */
+	void bind(vulkan::command_buffer &command_buffer, u32 submesh, bool depth_only = false);
+
+	/* Instanced draw of one submesh LOD, instance data must be bound at instance_binding. */
+	void draw(vulkan::command_buffer &command_buffer, u32 submesh, u32 lod, u32 first_instance, u32 instance_count,
+	          bool depth_only = false);
+
+	/* Mesh shading path, requires the mesh shader device feature. bind_meshlets binds the pipeline, bindless
+	 * textures, scene uniforms and meshlet buffers, the caller then sets the culling uniforms and instance storage
+	 * buffer at the bindings below. Meshlets cover the first LOD only. */
+	void bind_meshlets(vulkan::command_buffer &command_buffer);
+	void draw_meshlets(vulkan::command_buffer &command_buffer, u32 submesh, u32 first_instance, u32 instance_count);
+
+	static constexpr u32 instance_binding = 1;
+	static constexpr u32 meshlet_culling_binding = 1;
+	static constexpr u32 meshlet_arena_vertex_binding = 2; /* The geometry arena vertex buffer. */
+	static constexpr u32 meshlet_binding = 3;
+	static constexpr u32 meshlet_vertex_binding = 4;
+	static constexpr u32 meshlet_triangle_binding = 5;
+	static constexpr u32 meshlet_instance_binding = 6;
+	static constexpr u32 enable_mipmapping_constant = 0; /* Specialization constant of basic.frag. */
+	static constexpr u32 material_uniform_binding = 0;   /* In the material set of each submesh. */
+
+	struct submesh
+	{
+		geometry_allocation m_geometry = {};
+		std::vector<assets::mesh_lod> m_lods = {}; /* Index ranges are relative to the geometry arena. */
+		uref<vulkan::texture> m_diffuse_texture = make_uref<vulkan::texture>();
+		u32 m_diffuse_texture_index = 0; /* Index in the bindless table. */
+		vulkan::buffer m_material_buffer = {};
+		uref<vulkan::descriptor_set> m_material_set = make_uref<vulkan::descriptor_set>();
+		glm::mat4 m_transform = glm::mat4(1.0f);
+		assets::mesh_bounds m_bounds = {};
+		u32 m_first_meshlet = 0;
+		u32 m_meshlet_count = 0;
+	};
+
+	u32 m_id = 0; /* Index in the scene, used in draw sort keys. */
+	ref<assets::model> m_model = {};
+	geometry_arena *m_geometry_arena = nullptr;
+	const vulkan::bindless_table *m_bindless_table = nullptr;
+	const vulkan::descriptor_set *m_pass_set = nullptr;
+	std::vector<submesh> m_submeshes = {};
+	vulkan::pipeline m_pipeline = {};
+	vulkan::pipeline m_depth_pipeline = {};
+
+	/* Meshlets of all submeshes, vertex indices are relative to the geometry arena. */
+	vulkan::pipeline m_mesh_pipeline = {};
+	vulkan::buffer m_meshlet_buffer = {};
+	vulkan::buffer m_meshlet_vertex_buffer = {};
+	vulkan::buffer m_meshlet_triangle_buffer = {};
+
+private:
+	void build_meshlets(vulkan::context &context);
+};
+
+/* Not an object, static meshes are drawn in instanced batches by the scene, see scene::draw. */
+class static_mesh
 {
 public:
 	static_mesh() = default;
@@ -54,17 +168,30 @@ public:
 	static_mesh(const static_mesh &) = delete;
 	static_mesh operator=(const static_mesh &) = delete;
 
-	void build(vulkan::context &context, ref<assets::model> model);
-	void draw(vulkan::command_buffer &command_buffer) override;
-	void update_material(VkSampleCountFlagBits sample_count);
+	void build(ref<static_model> model);
+	glm::mat4 get_submesh_transform(u32 submesh) const;
+	glm::vec4 get_submesh_bounding_sphere(u32 submesh) const; /* World space center and radius. */
 
-	ref<assets::model> m_model;
-	vulkan::buffer m_vertex_buffer = {};
-	u32 m_index_count = 0;
-	vulkan::buffer m_index_buffer = {};
-	vulkan::texture m_diffuse_texture = {};
-	vulkan::pipeline m_pipeline = {};
+	/* Recomputes world space bounds and marks the mesh as moved, must be called whenever m_uniforms.model changes. */
+	void update_bounds();
+
+	/* Picks the coarsest LOD per submesh whose projected error is below error_threshold pixels, projected from the
+	 * nearest point of its world space bounding sphere. Requires up to date bounds, see update_bounds. */
+	void select_lod(const camera &camera, float viewport_height, float error_threshold);
+
+	struct world_bounds
+	{
+		glm::vec3 center = {};
+		glm::vec3 extent = {};
+		glm::vec4 sphere = {};
+	};
+
+	ref<static_model> m_model = {};
+	std::vector<u32> m_lods = {};            /* Selected LOD per submesh. */
+	std::vector<world_bounds> m_bounds = {}; /* World space bounds per submesh. */
 	object_uniforms m_uniforms = {};
+	u32 m_first_submesh = 0; /* Index of the first submesh in the scene's static submeshes. */
+	bool m_moved = true;     /* Cleared once the scene has updated its copies of the bounds. */
 
 private:
 };
@@ -82,6 +209,15 @@ public:
 	void update(float aspect_ratio);
 	void draw(vulkan::command_buffer &command_buffer) override;
 
+	glm::vec3 get_position() const;
+	float get_far_plane() const;
+
+	/* Left, right, bottom, top, near, far planes of m_projection * m_view, normals point inwards. */
+	void get_frustum_planes(glm::vec4 planes[6]) const;
+
+	/* Pixels per unit of size at unit distance, for projecting world space errors to the screen. */
+	float get_projection_scale(float viewport_height) const;
+
 	/* Needed by rendering. */
 	glm::mat4 m_view;
 	glm::mat4 m_projection;
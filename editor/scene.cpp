@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cstring>
 
 #include "scene.h"
 
@@ -20,34 +23,55 @@ void scene::build(vulkan::context &context, const settings &settings)
 	/* Scene uniforms. */
 	m_uniform_buffer =
 	    context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(m_uniforms));
+	m_pass_set.add_binding(uniform_binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+	m_pass_set.build(context.m_device);
+	m_pass_set.write_uniform_buffer(uniform_binding, m_uniform_buffer);
+
+	/* Meshlet culling uniforms, used by the mesh shading path. */
+	m_meshlet_culling_buffer = context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+	                                                                        sizeof(meshlet_culling_uniforms));
 
 	/* Camera. */
 	const glm::vec3 camera_position = glm::vec3(3.0f, 2.0f, 5.0f);
 	const glm::vec3 camera_target = glm::vec3(0.0f);
 	m_camera.build(camera_position, camera_target);
 
+	/* Geometry arena shared by all static models. */
+	constexpr VkDeviceSize vertex_arena_size = 64 * 1024 * 1024;
+	constexpr VkDeviceSize index_arena_size = 32 * 1024 * 1024;
+	m_geometry_arena.build(context, sizeof(packed_vertex), sizeof(packed_position), vertex_arena_size,
+	                       index_arena_size);
+
 	/* Static mesh objects. */
 	ref<assets::model> model = make_ref<assets::model>();
 	model->load("bin/assets/models/DamagedHelmet.glb");
+	ref<static_model> helmet = make_ref<static_model>();
+	helmet->build(context, m_geometry_arena, m_pass_set, model);
+	helmet->m_id = m_static_models.size();
+	m_static_models.push_back(helmet);
 	for (int x = -2; x <= 2; ++x)
 	{
 		for (int y = -1; y <= 1; ++y)
 		{
 			ref<static_mesh> new_static_mesh = make_ref<static_mesh>();
-			new_static_mesh->build(context, model);
+			new_static_mesh->build(helmet);
 			new_static_mesh->m_uniforms.model =
 			    glm::translate(new_static_mesh->m_uniforms.model, glm::vec3((float)x * 2.0f, 0.0f, (float)y * 2.0f));
-
-			entity e = create_entity();
-			m_static_mesh_storage[e] = new_static_mesh;
+			new_static_mesh->update_bounds();
+			add_static_mesh(new_static_mesh);
 		}
 	}
 
+	/* GPU-driven static mesh culling, optional. */
+	if (context.m_device.m_features.m_draw_indirect_count)
+	{
+		m_gpu_culling.build(context);
+	}
+
 	/* Skybox object. */
 	entity skybox_e = create_entity();
 	m_skybox_storage[skybox_e] = make_ref<skybox>();
-	m_skybox_storage[skybox_e]->build(context);
-	m_default_pipeline = &m_skybox_storage[skybox_e]->m_pipeline;
+	m_skybox_storage[skybox_e]->build(context, m_pass_set);
 
 	/* Grid. */
 	ref<assets::model> grid_model = make_ref<assets::model>();
@@ -86,15 +110,27 @@ void scene::build(vulkan::context &context, const settings &settings)
 	m_plane.m_pipeline.set_blend_enable(VK_TRUE);
 	m_plane.m_pipeline.build(context.m_device);
 
+	/* Static draws recorded into a secondary command buffer. */
+	m_static_draws.build(context.m_device);
+
 	/* (TODO, thoave01): Updates based on settings, should be part of initialization. */
-	for (auto &[e, static_mesh] : m_static_mesh_storage)
+	for (ref<static_model> &static_model : m_static_models)
 	{
-		static_mesh->update_material(settings.sample_count);
+		static_model->update_material(settings.sample_count, settings.enable_depth_prepass,
+		                              settings.enable_mipmapping, false);
 	}
 	for (auto &[e, skybox] : m_skybox_storage)
 	{
-		skybox->update_material(settings.sample_count);
+		skybox->update_material(settings.sample_count, false);
 	}
+
+	/* Startup waits for the initial materials. */
+	context.m_pipeline_registry.wait_idle();
+	context.m_pipeline_registry.swap_pending();
+	m_sample_count = settings.sample_count;
+	m_requested_sample_count = settings.sample_count;
+	m_prepass_materials = settings.enable_depth_prepass;
+	m_requested_prepass_materials = settings.enable_depth_prepass;
 }
 
 void scene::update(vulkan::context &context, const settings &settings)
@@ -108,28 +144,509 @@ void scene::update(vulkan::context &context, const settings &settings)
 	m_uniforms.enable_mipmapping = settings.enable_mipmapping;
 	m_uniform_buffer.fill(&m_uniforms, sizeof(m_uniforms));
 
-	/* Update materials. */
+	/* Group static meshes into instanced draws and sort everything into the render queue. */
+	update_static_submeshes(context);
+	build_static_mesh_batches(context, settings);
+	build_render_queue(settings);
+
+	/* The sky and transparent layers are recorded once, see draw_cached. */
+	static bool prev_skybox = settings.enable_skybox;
+	static bool prev_grid = settings.enable_grid;
+	if (prev_skybox != settings.enable_skybox || prev_grid != settings.enable_grid)
+	{
+		prev_skybox = settings.enable_skybox;
+		prev_grid = settings.enable_grid;
+		m_static_draws.invalidate();
+	}
+
+	/* Update materials. Shader objects read the material state when bound, so pipeline compiles are deferred while
+	 * they are enabled and requested once they are disabled again. */
+	const bool defer_compiles = settings.enable_shader_objects && context.m_device.m_features.m_shader_object;
+	static bool prev_defer_compiles = defer_compiles;
+	if (prev_defer_compiles && !defer_compiles)
+	{
+		for (ref<static_model> &static_model : m_static_models)
+		{
+			static_model->flush_material();
+		}
+		for (auto &[e, skybox] : m_skybox_storage)
+		{
+			skybox->flush_material();
+		}
+		m_grid.m_pipeline.flush_deferred_update();
+		m_plane.m_pipeline.flush_deferred_update();
+	}
+	prev_defer_compiles = defer_compiles;
+
+	static bool prev_depth_prepass = settings.enable_depth_prepass;
+	if (prev_depth_prepass != settings.enable_depth_prepass)
+	{
+		prev_depth_prepass = settings.enable_depth_prepass;
+		m_requested_prepass_materials = settings.enable_depth_prepass;
+
+		for (ref<static_model> &static_model : m_static_models)
+		{
+			static_model->update_material(settings.sample_count, settings.enable_depth_prepass,
+			                              settings.enable_mipmapping, defer_compiles);
+		}
+	}
+
+	static bool prev_mipmapping = settings.enable_mipmapping;
+	if (prev_mipmapping != settings.enable_mipmapping)
+	{
+		prev_mipmapping = settings.enable_mipmapping;
+
+		for (ref<static_model> &static_model : m_static_models)
+		{
+			static_model->update_material(settings.sample_count, settings.enable_depth_prepass,
+			                              settings.enable_mipmapping, defer_compiles);
+		}
+	}
+
 	static u32 prev_sample_count = VK_SAMPLE_COUNT_1_BIT;
 	if (prev_sample_count != settings.sample_count)
 	{
 		prev_sample_count = settings.sample_count;
+		m_requested_sample_count = settings.sample_count;
 
-		for (auto &[e, static_mesh] : m_static_mesh_storage)
+		for (ref<static_model> &static_model : m_static_models)
 		{
-			static_mesh->update_material(settings.sample_count);
+			static_model->update_material(settings.sample_count, settings.enable_depth_prepass,
+			                              settings.enable_mipmapping, defer_compiles);
 		}
 		for (auto &[e, skybox] : m_skybox_storage)
 		{
-			skybox->update_material(settings.sample_count);
+			skybox->update_material(settings.sample_count, defer_compiles);
 		}
 		m_grid.m_pipeline.set_sample_count(settings.sample_count);
-		m_grid.m_pipeline.update();
 		m_plane.m_pipeline.set_sample_count(settings.sample_count);
-		m_plane.m_pipeline.update();
+		if (defer_compiles)
+		{
+			m_grid.m_pipeline.defer_update();
+			m_plane.m_pipeline.defer_update();
+		}
+		else
+		{
+			m_grid.m_pipeline.update();
+			m_plane.m_pipeline.update();
+		}
+		m_static_draws.invalidate();
+	}
+
+	/* Materials compile in the background and the previous pipelines keep drawing meanwhile. Attachments and passes
+	 * follow once all of them have been swapped in, this frame if only dynamic state changed. Shader objects read
+	 * the material state when bound, nothing waits for compiles. Switching back to pipelines waits too. */
+	const bool swapped = context.m_pipeline_registry.swap_pending();
+	const bool shader_objects = m_shader_objects;
+	m_shader_objects = context.m_device.m_features.m_shader_object &&
+	                   (settings.enable_shader_objects || (m_shader_objects && !swapped));
+	if (context.m_pipeline_registry.m_handles_swapped || shader_objects != m_shader_objects)
+	{
+		m_static_draws.invalidate();
+	}
+	if (swapped || m_shader_objects)
+	{
+		m_sample_count = m_requested_sample_count;
+		m_prepass_materials = m_requested_prepass_materials;
+	}
+
+	/* Mesh shading replaces the CPU culled batch draws, it has no depth-only variant. Mesh pipelines are always bound
+	 * as VkPipelines, so they are off while shader objects switch the sample count ahead of pipeline swaps. */
+	m_mesh_shading = settings.enable_mesh_shading && context.m_device.m_features.m_mesh_shader && !m_gpu_driven &&
+	                 !m_shader_objects;
+	if (m_mesh_shading)
+	{
+		meshlet_culling_uniforms culling = {};
+		m_camera.get_frustum_planes(culling.planes);
+		culling.camera_position = glm::vec4(m_camera.get_position(), 1.0f);
+		m_meshlet_culling_buffer.fill(&culling, sizeof(culling));
+	}
+
+	/* Shading pipelines test EQUAL until the materials without the pre-pass are swapped in. */
+	m_depth_prepass = (settings.enable_depth_prepass || m_prepass_materials) && !m_mesh_shading;
+}
+
+void scene::cull_static_meshes(vulkan::command_buffer &command_buffer)
+{
+	if (m_gpu_driven)
+	{
+		m_gpu_culling.cull(command_buffer, m_depth_pyramid, 0);
+	}
+}
+
+void scene::occlude_static_meshes(vulkan::command_buffer &command_buffer, const vulkan::texture &depth)
+{
+	if (!m_occlusion_culling)
+	{
+		return;
+	}
+
+	/* First phase attachments, draws and instance reads finish before the pyramid and second phase cull, and the
+	 * attachments are loaded again afterwards. */
+	command_buffer.memory_barrier(
+	    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+	        VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+	        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+	    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+	    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+	        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+	    VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+	        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+	        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+
+	m_depth_pyramid.generate(command_buffer, depth);
+	m_gpu_culling.cull(command_buffer, m_depth_pyramid, 1);
+}
+
+void scene::draw_occluded_static_meshes(vulkan::command_buffer &command_buffer)
+{
+	if (!m_occlusion_culling)
+	{
+		return;
+	}
+
+	if (m_depth_prepass)
+	{
+		m_geometry_arena.bind_position_buffer(command_buffer);
+		m_gpu_culling.draw(command_buffer, 1, true);
+		m_geometry_arena.bind_vertex_buffer(command_buffer);
+	}
+	m_gpu_culling.draw(command_buffer, 1);
+}
+
+void scene::draw(vulkan::command_buffer &command_buffer, render_layer layer)
+{
+	bool instances_bound = false;
+	for (const draw_packet &packet : m_render_queue.get_layer(layer))
+	{
+		switch (packet.m_type)
+		{
+		case scene_draw_static_mesh_batch:
+		{
+			const static_mesh_batch &batch = m_static_mesh_batches[packet.m_index];
+			if (m_mesh_shading)
+			{
+				/* Batches are still split by LOD, the task shader culls per meshlet instead. */
+				batch.m_model->bind_meshlets(command_buffer);
+				command_buffer.set_uniform_buffer(static_model::meshlet_culling_binding, m_meshlet_culling_buffer,
+				                                  VK_PIPELINE_BIND_POINT_GRAPHICS);
+				command_buffer.set_storage_buffer(static_model::meshlet_instance_binding, m_instance_buffer,
+				                                  VK_PIPELINE_BIND_POINT_GRAPHICS);
+				batch.m_model->draw_meshlets(command_buffer, batch.m_submesh, batch.m_first_instance,
+				                             batch.m_instance_count);
+				break;
+			}
+			if (!instances_bound)
+			{
+				command_buffer.bind_vertex_buffer(static_model::instance_binding, m_instance_buffer, 0);
+				instances_bound = true;
+			}
+			batch.m_model->draw(command_buffer, batch.m_submesh, batch.m_lod, batch.m_first_instance,
+			                    batch.m_instance_count);
+			break;
+		}
+		case scene_draw_gpu_static_meshes:
+			m_gpu_culling.draw(command_buffer, 0);
+			break;
+		case scene_draw_skybox:
+			m_skybox_storage.at(packet.m_index)->draw(command_buffer);
+			break;
+		case scene_draw_grid:
+			command_buffer.bind_pipeline(m_grid.m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+			command_buffer.bind_vertex_buffer(0, m_grid.m_vertex_buffer, 0);
+			m_pass_set.bind(command_buffer, vulkan::descriptor_set_pass, VK_PIPELINE_BIND_POINT_GRAPHICS);
+			vkCmdDraw(command_buffer.m_handle, m_grid.m_vertex_count, 1, 0, 0);
+			break;
+		case scene_draw_plane:
+			command_buffer.bind_pipeline(m_plane.m_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+			command_buffer.bind_vertex_buffer(0, m_plane.m_vertex_buffer, 0);
+			m_pass_set.bind(command_buffer, vulkan::descriptor_set_pass, VK_PIPELINE_BIND_POINT_GRAPHICS);
+			vkCmdDraw(command_buffer.m_handle, m_plane.m_vertex_count, 1, 0, 0);
+			break;
+		default:
+			assert_if(true, "Unknown scene draw type %u", packet.m_type);
+			break;
+		}
+	}
+}
+
+void scene::draw_depth(vulkan::command_buffer &command_buffer)
+{
+	m_geometry_arena.bind_position_buffer(command_buffer);
+
+	bool instances_bound = false;
+	for (const draw_packet &packet : m_render_queue.get_layer(render_layer_opaque))
+	{
+		switch (packet.m_type)
+		{
+		case scene_draw_static_mesh_batch:
+		{
+			if (!instances_bound)
+			{
+				command_buffer.bind_vertex_buffer(static_model::instance_binding, m_instance_buffer, 0);
+				instances_bound = true;
+			}
+			const static_mesh_batch &batch = m_static_mesh_batches[packet.m_index];
+			batch.m_model->draw(command_buffer, batch.m_submesh, batch.m_lod, batch.m_first_instance,
+			                    batch.m_instance_count, true);
+			break;
+		}
+		case scene_draw_gpu_static_meshes:
+			m_gpu_culling.draw(command_buffer, 0, true);
+			break;
+		default:
+			assert_if(true, "Scene draw type %u has no depth-only draw", packet.m_type);
+			break;
+		}
+	}
+}
+
+void scene::draw_cached(vulkan::command_buffer &command_buffer, const vulkan::rendering_formats &formats,
+                        const VkViewport &viewport, const VkRect2D &scissor)
+{
+	/* Viewport and scissor are recorded as dynamic state, pipelines and draws are invalidated in update. */
+	if (0 != std::memcmp(&viewport, &m_cached_viewport, sizeof(viewport)) ||
+	    0 != std::memcmp(&scissor, &m_cached_scissor, sizeof(scissor)))
+	{
+		m_cached_viewport = viewport;
+		m_cached_scissor = scissor;
+		m_static_draws.invalidate();
+	}
+
+	/* Nothing is inherited from the primary command buffer. */
+	m_static_draws.execute(command_buffer, formats,
+	                       [&](vulkan::command_buffer &secondary)
+	                       {
+		                       secondary.set_shader_objects(m_shader_objects);
+		                       secondary.set_viewport(viewport);
+		                       secondary.set_scissor(scissor);
+		                       draw(secondary, render_layer_sky);
+		                       draw(secondary, render_layer_transparent);
+	                       });
+}
+
+void scene::update_static_submeshes(vulkan::context &context)
+{
+	/* Adding static meshes rebuilds the submesh order, culling bounds and GPU-driven instances, otherwise only the
+	 * submeshes of moved static meshes are written. */
+	const bool gpu_culling = context.m_device.m_features.m_draw_indirect_count;
+	if (m_static_submeshes_dirty)
+	{
+		m_static_submeshes.clear();
+		m_culling_bounds.clear();
+		for (auto &[e, static_mesh] : m_static_mesh_storage)
+		{
+			static_mesh->m_first_submesh = m_static_submeshes.size();
+			static_mesh->m_moved = false;
+			for (u32 s = 0; s < static_mesh->m_model->m_submeshes.size(); ++s)
+			{
+				const static_mesh::world_bounds &bounds = static_mesh->m_bounds[s];
+				m_static_submeshes.push_back({ .m_mesh = static_mesh.get(), .m_submesh = s });
+				m_culling_bounds.push_back(bounds.center, bounds.extent);
+			}
+		}
+		if (gpu_culling)
+		{
+			m_gpu_culling.build_instances(context, m_static_submeshes);
+		}
+		m_static_submeshes_dirty = false;
+		return;
+	}
+
+	for (auto &[e, static_mesh] : m_static_mesh_storage)
+	{
+		if (!static_mesh->m_moved)
+		{
+			continue;
+		}
+		for (u32 s = 0; s < static_mesh->m_model->m_submeshes.size(); ++s)
+		{
+			const u32 index = static_mesh->m_first_submesh + s;
+			m_culling_bounds.set(index, static_mesh->m_bounds[s].center, static_mesh->m_bounds[s].extent);
+			if (gpu_culling)
+			{
+				m_gpu_culling.update_instance(index, m_static_submeshes[index]);
+			}
+		}
+		static_mesh->m_moved = false;
 	}
 }
 
+void scene::build_static_mesh_batches(vulkan::context &context, const settings &settings)
+{
+	m_gpu_driven = settings.enable_gpu_culling && context.m_device.m_features.m_draw_indirect_count;
+	m_occlusion_culling = m_gpu_driven && settings.enable_occlusion_culling;
+	if (m_gpu_driven)
+	{
+		m_depth_pyramid.build(context, settings.viewport_width, settings.viewport_height);
+	}
+	if (!m_occlusion_culling)
+	{
+		/* Not regenerated this frame, so it will not match the previous view next frame. */
+		m_depth_pyramid.m_valid = false;
+	}
+
+	/* The GPU-driven path culls and selects LODs on the GPU, from instances that persist across frames. */
+	m_culling_statistics = { .tested = (u32)m_static_submeshes.size(), .visible = (u32)m_static_submeshes.size() };
+	if (m_gpu_driven)
+	{
+		glm::vec4 planes[6];
+		m_camera.get_frustum_planes(planes);
+		const gpu_lod_selection lod = {
+			.enable = settings.enable_lod,                                                      //
+			.projection_scale = m_camera.get_projection_scale((float)settings.viewport_height), //
+			.error_threshold = settings.lod_error_threshold,                                    //
+		};
+		m_gpu_culling.update(planes, m_camera.m_projection * m_camera.m_view, m_camera.get_position(), lod,
+		                     m_depth_pyramid, m_occlusion_culling);
+		m_static_mesh_batches.clear();
+		return;
+	}
+
+	/* Select LODs. */
+	for (auto &[e, static_mesh] : m_static_mesh_storage)
+	{
+		if (settings.enable_lod)
+		{
+			static_mesh->select_lod(m_camera, (float)settings.viewport_height, settings.lod_error_threshold);
+		}
+		else
+		{
+			std::fill(static_mesh->m_lods.begin(), static_mesh->m_lods.end(), 0);
+		}
+	}
+
+	/* Sort submesh draws by model, submesh, LOD and depth. Each state run becomes one instanced draw, with its
+	 * instances front to back. */
+	struct submesh_draw
+	{
+		static_model *model;
+		u32 submesh;
+		u32 lod;
+		instance_data instance;
+		glm::vec4 sphere;
+	};
+	std::vector<submesh_draw> draws = {};
+	draws.reserve(m_static_submeshes.size());
+	for (const static_submesh &submesh : m_static_submeshes)
+	{
+		const static_mesh &mesh = *submesh.m_mesh;
+		draws.push_back({ mesh.m_model.get(), submesh.m_submesh, mesh.m_lods[submesh.m_submesh],
+		                  { .model = mesh.get_submesh_transform(submesh.m_submesh) },
+		                  mesh.get_submesh_bounding_sphere(submesh.m_submesh) });
+	}
+
+	/* CPU frustum culling, the bounds follow the submesh order. */
+	if (settings.enable_frustum_culling)
+	{
+		glm::vec4 planes[6];
+		m_camera.get_frustum_planes(planes);
+		m_culling_statistics.visible = cull_aabbs(planes, m_culling_bounds, m_culling_visibility);
+
+		u32 visible_draw_count = 0;
+		for (u32 d = 0; d < draws.size(); ++d)
+		{
+			if (m_culling_visibility[d])
+			{
+				draws[visible_draw_count++] = draws[d];
+			}
+		}
+		draws.resize(visible_draw_count);
+	}
+
+	const glm::vec3 camera_position = m_camera.get_position();
+	const float far_plane = m_camera.get_far_plane();
+	std::vector<draw_packet> packets(draws.size());
+	std::vector<draw_packet> scratch = {};
+	for (u32 d = 0; d < draws.size(); ++d)
+	{
+		const submesh_draw &draw = draws[d];
+		const float depth = (glm::length(glm::vec3(draw.sphere) - camera_position) - draw.sphere.w) / far_plane;
+		packets[d] = { .m_key = make_draw_key(render_layer_opaque, draw.model->m_id, draw.submesh, draw.lod, depth),
+			           .m_type = scene_draw_static_mesh_batch,
+			           .m_index = d };
+	}
+	radix_sort(packets, scratch);
+
+	std::vector<instance_data> instances = {};
+	instances.reserve(draws.size());
+	m_static_mesh_batches.clear();
+	for (const draw_packet &packet : packets)
+	{
+		const submesh_draw &draw = draws[packet.m_index];
+		if (m_static_mesh_batches.empty() ||
+		    get_draw_state(m_static_mesh_batches.back().m_key) != get_draw_state(packet.m_key))
+		{
+			m_static_mesh_batches.push_back({ .m_model = draw.model,
+			                                  .m_submesh = draw.submesh,
+			                                  .m_lod = draw.lod,
+			                                  .m_first_instance = (u32)instances.size(),
+			                                  .m_instance_count = 0,
+			                                  .m_key = packet.m_key });
+		}
+		++m_static_mesh_batches.back().m_instance_count;
+		instances.push_back(draw.instance);
+	}
+
+	/* Grow the instance buffer, the previous frame has finished by the time we update. */
+	const VkDeviceSize instances_size = std::max(instances.size(), (size_t)1) * sizeof(instance_data);
+	if (m_instance_buffer.m_size < instances_size)
+	{
+		m_instance_buffer = context.m_resource_allocator.allocate_buffer(
+		    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, std::bit_ceil(instances_size));
+	}
+	if (!instances.empty())
+	{
+		m_instance_buffer.fill(instances.data(), instances.size() * sizeof(instance_data));
+	}
+}
+
+void scene::build_render_queue(const settings &settings)
+{
+	m_render_queue.clear();
+
+	/* Opaque static meshes, culled GPU-driven batches are drawn as one packet. */
+	if (m_gpu_driven)
+	{
+		m_render_queue.push(make_draw_key(render_layer_opaque, 0, 0, 0, 0.0f), scene_draw_gpu_static_meshes, 0);
+	}
+	else
+	{
+		for (u32 b = 0; b < m_static_mesh_batches.size(); ++b)
+		{
+			m_render_queue.push(m_static_mesh_batches[b].m_key, scene_draw_static_mesh_batch, b);
+		}
+	}
+
+	/* Skybox after opaque geometry so that covered pixels fail the depth test. */
+	if (settings.enable_skybox)
+	{
+		for (auto &[e, skybox] : m_skybox_storage)
+		{
+			m_render_queue.push(make_draw_key(render_layer_sky, 0, 0, 0, 1.0f), scene_draw_skybox, (u32)e);
+		}
+	}
+
+	/* Blended grid and plane last, the mesh bits keep the grid below the plane. */
+	if (settings.enable_grid)
+	{
+		m_render_queue.push(make_draw_key(render_layer_transparent, 0, 0, 0, 0.0f), scene_draw_grid, 0);
+		m_render_queue.push(make_draw_key(render_layer_transparent, 1, 0, 0, 0.0f), scene_draw_plane, 0);
+	}
+
+	m_render_queue.sort();
+}
+
 entity scene::create_entity()
 {
 	return m_entity++;
 }
+
+entity scene::add_static_mesh(const ref<static_mesh> &static_mesh)
+{
+	const entity e = create_entity();
+	m_static_mesh_storage[e] = static_mesh;
+	m_static_submeshes_dirty = true;
+	return e;
+}
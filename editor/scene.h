@@ -4,12 +4,18 @@
 
 #include <assets/image.h>
 #include <assets/model.h>
+#include <renderer/geometry_arena.h>
+#include <renderer/render_queue.h>
 #include <renderer/vulkan/buffer.h>
 #include <renderer/vulkan/command_buffer.h>
+#include <renderer/vulkan/command_cache.h>
 #include <renderer/vulkan/context.h>
+#include <renderer/vulkan/descriptor_set.h>
 #include <renderer/vulkan/image.h>
 #include <utils/util.h>
 
+#include "culling.h"
+#include "gpu_culling.h"
 #include "object.h"
 #include "settings.h"
 
@@ -41,6 +47,35 @@ struct scene_uniforms
 };
 static_assert(sizeof(scene_uniforms) == 4 * 4 * 4 * 2 + sizeof(u32), "Unexpected scene struct uniform size");
 
+/* Static mesh submeshes sharing model, submesh and LOD, drawn with a single instanced draw. */
+struct static_mesh_batch
+{
+	static_model *m_model = nullptr;
+	u32 m_submesh = 0;
+	u32 m_lod = 0;
+	u32 m_first_instance = 0;
+	u32 m_instance_count = 0;
+	u64 m_key = 0; /* Sort key of the nearest instance. */
+};
+
+/* Submesh of a static mesh. The submeshes of all static meshes keep their order until static meshes are added, and
+ * index the culling bounds and GPU-driven instances. */
+struct static_submesh
+{
+	static_mesh *m_mesh = nullptr;
+	u32 m_submesh = 0;
+};
+
+/* Render queue packet types of the scene. */
+enum scene_draw_type : u32
+{
+	scene_draw_static_mesh_batch = 0,
+	scene_draw_gpu_static_meshes = 1,
+	scene_draw_skybox = 2,
+	scene_draw_grid = 3,
+	scene_draw_plane = 4,
+};
+
 class scene
 {
 public:
@@ -52,15 +87,62 @@ public:
 
 	void build(vulkan::context &context, const settings &settings);
 	void update(vulkan::context &context, const settings &settings);
+	void cull_static_meshes(vulkan::command_buffer &command_buffer);
+
+	/* Records the sorted render queue packets of one layer. */
+	void draw(vulkan::command_buffer &command_buffer, render_layer layer);
+
+	/* Depth-only draw of the opaque layer from the position stream, before the opaque layer is shaded with an EQUAL
+	 * depth test. Leaves the position stream bound. */
+	void draw_depth(vulkan::command_buffer &command_buffer);
+
+	/* Occlusion culling second phase, between the two halves of the main pass. The depth must be single sampled. */
+	void occlude_static_meshes(vulkan::command_buffer &command_buffer, const vulkan::texture &depth);
+	void draw_occluded_static_meshes(vulkan::command_buffer &command_buffer);
+
+	/* Records the sky and transparent layers once into a secondary command buffer and replays it until update
+	 * invalidates it, or the viewport or formats change. Rendering must allow secondary command buffers. */
+	void draw_cached(vulkan::command_buffer &command_buffer, const vulkan::rendering_formats &formats,
+	                 const VkViewport &viewport, const VkRect2D &scissor);
 
 	camera m_camera = {};
 	scene_uniforms m_uniforms = {};
 	vulkan::buffer m_uniform_buffer = {};
-	vulkan::pipeline *m_default_pipeline = nullptr;
+	/* Scene uniforms at uniform_binding, bound at vulkan::descriptor_set_pass by everything drawn in the scene. */
+	vulkan::descriptor_set m_pass_set = {};
+	static constexpr u32 uniform_binding = 0;
 
 	entity create_entity();
+	entity add_static_mesh(const ref<static_mesh> &static_mesh);
+
+	geometry_arena m_geometry_arena = {};
+	std::vector<ref<static_model>> m_static_models = {};
 
 	estorage<ref<static_mesh>> m_static_mesh_storage = {};
+	std::vector<static_submesh> m_static_submeshes = {};
+	std::vector<static_mesh_batch> m_static_mesh_batches = {};
+	vulkan::buffer m_instance_buffer = {};
+	gpu_culling m_gpu_culling = {};
+	depth_pyramid m_depth_pyramid = {};
+	bool m_gpu_driven = false;
+	bool m_occlusion_culling = false;
+	bool m_depth_prepass = false;
+	bool m_mesh_shading = false;
+
+	/* Sample count of the pipelines in use, the attachments must match it. */
+	VkSampleCountFlagBits m_sample_count = VK_SAMPLE_COUNT_1_BIT;
+	bool m_shader_objects = false;
+	vulkan::buffer m_meshlet_culling_buffer = {};
+
+	aabb_soa m_culling_bounds = {};
+	std::vector<u8> m_culling_visibility = {};
+	culling_statistics m_culling_statistics = {};
+
+	render_queue m_render_queue = {};
+	vulkan::command_cache m_static_draws = {};
+	VkViewport m_cached_viewport = {};
+	VkRect2D m_cached_scissor = {};
+
 	estorage<ref<skybox>> m_skybox_storage = {};
 
 	struct
@@ -78,5 +160,15 @@ public:
 	} m_plane;
 
 private:
+	void update_static_submeshes(vulkan::context &context);
+	void build_static_mesh_batches(vulkan::context &context, const settings &settings);
+	void build_render_queue(const settings &settings);
+
 	entity m_entity = 0;
+	bool m_static_submeshes_dirty = false;
+
+	/* Material state requested from the pipeline registry, and the state of the pipelines in use. */
+	VkSampleCountFlagBits m_requested_sample_count = VK_SAMPLE_COUNT_1_BIT;
+	bool m_prepass_materials = false;
+	bool m_requested_prepass_materials = false;
 };
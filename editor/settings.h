@@ -15,6 +15,15 @@ struct settings
 	bool enable_mipmapping;
 	bool enable_skybox;
 	bool enable_grid;
+	bool enable_lod;
+	float lod_error_threshold; /* In pixels. */
+	bool enable_frustum_culling;
+	bool enable_gpu_culling;
+	bool enable_occlusion_culling; /* Requires GPU culling. */
+	bool enable_command_caching;   /* Static draws replayed from secondary command buffers. */
+	bool enable_depth_prepass;     /* Opaque depth laid down before shading. */
+	bool enable_mesh_shading;      /* Requires mesh shaders and no shader objects, replaces the CPU culled draws. */
+	bool enable_shader_objects;    /* Requires shader objects, graphics state is set dynamically. */
 	VkSampleCountFlagBits sample_count;
 	VkFormat color_format;
 	VkFormat depth_format;
@@ -44,7 +44,7 @@ void ui::build(editor &editor)
 	init_info.Device = m_editor->m_context.m_device.m_logical.m_handle;
 	init_info.QueueFamily = *m_editor->m_context.m_device.m_physical.m_queue_family.m_all;
 	init_info.Queue = m_editor->m_context.m_queue.m_handle;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = m_editor->m_context.m_device.m_pipeline_cache;
 	init_info.DescriptorPoolSize = 1024; /* Number of combined image samplers. */
 	init_info.UseDynamicRendering = VK_TRUE;
 	init_info.PipelineRenderingCreateInfo = {};
@@ -88,6 +88,7 @@ void ui::generate_frame()
 void ui::draw(vulkan::command_buffer &command_buffer)
 {
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), command_buffer.m_handle);
+	command_buffer.invalidate();
 }
 
 static ImGuiID get_dockspace_id()
@@ -152,7 +153,8 @@ void ui::generate_scene()
 			{
 				for (auto &[e, static_mesh] : m_editor->m_scene.m_static_mesh_storage)
 				{
-					ImGui::Text("[e%lu] Static mesh", e);
+					ImGui::Text("[e%lu] Static mesh (%zu submeshes, LOD %u)", e, static_mesh->m_lods.size(),
+					            static_mesh->m_lods.empty() ? 0 : static_mesh->m_lods[0]);
 				}
 				ImGui::TreePop();
 			}
@@ -175,6 +177,23 @@ void ui::generate_settings()
 		ImGui::Checkbox("Skybox", &m_editor->m_settings.enable_skybox);
 		ImGui::Checkbox("Mipmapping", &m_editor->m_settings.enable_mipmapping);
 		ImGui::Checkbox("Enable grid", &m_editor->m_settings.enable_grid);
+		ImGui::Checkbox("Enable LOD", &m_editor->m_settings.enable_lod);
+		ImGui::SliderFloat("LOD error (px)", &m_editor->m_settings.lod_error_threshold, 0.1f, 16.0f, "%.1f");
+		ImGui::Checkbox("Frustum culling", &m_editor->m_settings.enable_frustum_culling);
+		ImGui::BeginDisabled(!m_editor->m_context.m_device.m_features.m_draw_indirect_count);
+		ImGui::Checkbox("GPU culling", &m_editor->m_settings.enable_gpu_culling);
+		ImGui::BeginDisabled(!m_editor->m_settings.enable_gpu_culling);
+		ImGui::Checkbox("Occlusion culling", &m_editor->m_settings.enable_occlusion_culling);
+		ImGui::EndDisabled();
+		ImGui::EndDisabled();
+		ImGui::Checkbox("Cache static draws", &m_editor->m_settings.enable_command_caching);
+		ImGui::Checkbox("Depth pre-pass", &m_editor->m_settings.enable_depth_prepass);
+		ImGui::BeginDisabled(!m_editor->m_context.m_device.m_features.m_mesh_shader);
+		ImGui::Checkbox("Mesh shading", &m_editor->m_settings.enable_mesh_shading);
+		ImGui::EndDisabled();
+		ImGui::BeginDisabled(!m_editor->m_context.m_device.m_features.m_shader_object);
+		ImGui::Checkbox("Shader objects", &m_editor->m_settings.enable_shader_objects);
+		ImGui::EndDisabled();
 		if (ImGui::Combo("##MSAA", &sample_count_selection, sample_counts.data(), sample_counts.size()))
 		{
 			switch (sample_count_selection)
@@ -230,6 +249,24 @@ void ui::generate_debug()
 		float fps_text_width = ImGui::CalcTextSize("FPS %.1f").x;
 		ImGui::SetCursorPosX(window_width + (window_width - fps_text_width) * 0.5f);
 		ImGui::Text("FPS %.1f", ImGui::GetIO().Framerate);
+
+		const culling_statistics &culling = m_editor->m_scene.m_culling_statistics;
+		ImGui::Text(" Visible %u/%u submeshes, %zu batches", culling.visible, culling.tested,
+		            m_editor->m_scene.m_static_mesh_batches.size());
+
+		/* Recorded last frame, statistics are reset when the command buffer begins. */
+		const vulkan::command_statistics &commands = m_editor->m_context.m_command_buffer.m_statistics;
+		ImGui::Text(" Commands %u issued, %u elided, static draws recorded %u times", commands.issued,
+		            commands.elided, m_editor->m_scene.m_static_draws.m_record_count);
+
+		const vulkan::pipeline_registry_statistics &pipelines = m_editor->m_context.m_pipeline_registry.m_statistics;
+		ImGui::Text(" Pipelines %u compiled for %u requests, %u pending, %u libraries", pipelines.pipeline_compiles,
+		            pipelines.pipeline_requests, pipelines.pipelines_pending, pipelines.library_compiles);
+		ImGui::Text(" Shader modules %u loaded for %u requests", pipelines.shader_compiles, pipelines.shader_requests);
+
+		/* Measured last frame, shading includes the occlusion culling second phase. */
+		ImGui::Text(" Depth pre-pass %.2f ms, shading %.2f ms", m_editor->m_pass_timings.m_depth_prepass_ms,
+		            m_editor->m_pass_timings.m_shading_ms);
 	}
 	ImGui::End();
 	ImGui::PopStyleVar();
@@ -0,0 +1,49 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.h"
+
+mapped_file::~mapped_file()
+{
+	if (nullptr != m_data)
+	{
+		munmap(const_cast<u8 *>(m_data), m_size);
+	}
+}
+
+bool mapped_file::build(const char *path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat = {};
+	if (0 != fstat(fd, &file_stat))
+	{
+		close(fd);
+		return false;
+	}
+
+	/* Empty files cannot be mapped, they are returned without data. */
+	if (0 == file_stat.st_size)
+	{
+		close(fd);
+		return true;
+	}
+
+	/* The mapping keeps its own reference to the file. */
+	void *data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == data)
+	{
+		return false;
+	}
+
+	m_data = static_cast<const u8 *>(data);
+	m_size = file_stat.st_size;
+	return true;
+}
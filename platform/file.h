@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+#include <utils/type.h>
+
+/* Read-only mapping of a whole file, unmapped on destruction. */
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	~mapped_file();
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file operator=(const mapped_file &) = delete;
+
+	/* Returns false if the file could not be opened or mapped. */
+	bool build(const char *path);
+
+	const u8 *m_data = nullptr;
+	size_t m_size = 0;
+};
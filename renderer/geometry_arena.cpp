@@ -0,0 +1,78 @@
+#include <renderer/vulkan/command_buffer.h>
+#include <renderer/vulkan/context.h>
+#include <utils/util.h>
+
+#include "geometry_arena.h"
+
+static u32 get_index_size(VkIndexType index_type)
+{
+	switch (index_type)
+	{
+	case VK_INDEX_TYPE_UINT16:
+		return sizeof(u16);
+	case VK_INDEX_TYPE_UINT32:
+		return sizeof(u32);
+	default:
+		assert_if(true, "Unsupported index type %d", index_type);
+		return 0;
+	}
+}
+
+void geometry_arena::build(vulkan::context &context, u32 vertex_stride, u32 position_stride,
+                           VkDeviceSize vertex_capacity, VkDeviceSize index_capacity)
+{
+	m_vertex_stride = vertex_stride;
+	m_position_stride = position_stride;
+	m_vertex_size = 0;
+	m_index_size = 0;
+	/* Mesh shaders read vertices as storage buffers. */
+	m_vertex_buffer = context.m_resource_allocator.allocate_buffer(
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vertex_capacity);
+	m_position_buffer = context.m_resource_allocator.allocate_buffer(
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_capacity / vertex_stride * position_stride);
+	m_index_buffer = context.m_resource_allocator.allocate_buffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, index_capacity);
+}
+
+geometry_allocation geometry_arena::allocate(const void *vertices, const void *positions, u32 vertex_count,
+                                             const void *indices, u32 index_count, VkIndexType index_type)
+{
+	const VkDeviceSize vertices_size = (VkDeviceSize)vertex_count * m_vertex_stride;
+	const u32 index_size = get_index_size(index_type);
+	const VkDeviceSize indices_size = (VkDeviceSize)index_count * index_size;
+
+	/* Keep every range aligned to the largest index size so firstIndex is exact for both index types. */
+	const VkDeviceSize index_offset = (m_index_size + sizeof(u32) - 1) & ~(VkDeviceSize)(sizeof(u32) - 1);
+	assert_if(m_vertex_size + vertices_size > m_vertex_buffer.m_size, "Geometry arena out of vertex memory");
+	assert_if(index_offset + indices_size > m_index_buffer.m_size, "Geometry arena out of index memory");
+
+	geometry_allocation allocation = {};
+	allocation.vertex_offset = (i32)(m_vertex_size / m_vertex_stride);
+	allocation.vertex_count = vertex_count;
+	allocation.first_index = (u32)(index_offset / index_size);
+	allocation.index_count = index_count;
+	allocation.index_type = index_type;
+
+	m_vertex_buffer.fill(vertices, vertices_size, m_vertex_size);
+	m_position_buffer.fill(positions, (VkDeviceSize)vertex_count * m_position_stride,
+	                       (VkDeviceSize)allocation.vertex_offset * m_position_stride);
+	m_index_buffer.fill(indices, indices_size, index_offset);
+	m_vertex_size += vertices_size;
+	m_index_size = index_offset + indices_size;
+
+	return allocation;
+}
+
+void geometry_arena::bind_vertex_buffer(vulkan::command_buffer &command_buffer) const
+{
+	command_buffer.bind_vertex_buffer(0, m_vertex_buffer, 0);
+}
+
+void geometry_arena::bind_position_buffer(vulkan::command_buffer &command_buffer) const
+{
+	command_buffer.bind_vertex_buffer(0, m_position_buffer, 0);
+}
+
+void geometry_arena::bind_index_buffer(vulkan::command_buffer &command_buffer, VkIndexType index_type) const
+{
+	command_buffer.bind_index_buffer(m_index_buffer, 0, index_type);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// clang-format off
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <third_party/volk/volk.h>
+#pragma clang diagnostic pop
+// clang-format on
+
+#include <renderer/vulkan/buffer.h>
+#include <utils/type.h>
+
+namespace vulkan
+{
+class command_buffer;
+class context;
+}
+
+/* Location of one mesh in the arena, used as firstIndex/vertexOffset in indexed draws. */
+struct geometry_allocation
+{
+	i32 vertex_offset = 0;
+	u32 vertex_count = 0;
+	u32 first_index = 0;
+	u32 index_count = 0;
+	VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+};
+
+/* Shared vertex and index buffers that meshes are suballocated from, so that all geometry can be bound once. 16-
+ * and 32-bit index ranges live in the same index buffer, only the bound index type changes between them. Positions
+ * are also stored in a separate stream at the same vertex offsets, for depth-only passes. */
+class geometry_arena
+{
+public:
+	geometry_arena() = default;
+	~geometry_arena() = default;
+
+	geometry_arena(const geometry_arena &) = delete;
+	geometry_arena operator=(const geometry_arena &) = delete;
+
+	void build(vulkan::context &context, u32 vertex_stride, u32 position_stride, VkDeviceSize vertex_capacity,
+	           VkDeviceSize index_capacity);
+	geometry_allocation allocate(const void *vertices, const void *positions, u32 vertex_count, const void *indices,
+	                             u32 index_count, VkIndexType index_type);
+
+	void bind_vertex_buffer(vulkan::command_buffer &command_buffer) const;
+	void bind_position_buffer(vulkan::command_buffer &command_buffer) const;
+	void bind_index_buffer(vulkan::command_buffer &command_buffer, VkIndexType index_type) const;
+
+	vulkan::buffer m_vertex_buffer = {};
+	vulkan::buffer m_position_buffer = {};
+	vulkan::buffer m_index_buffer = {};
+
+private:
+	u32 m_vertex_stride = 0;
+	u32 m_position_stride = 0;
+	VkDeviceSize m_vertex_size = 0;
+	VkDeviceSize m_index_size = 0;
+};
@@ -61,6 +61,24 @@ render_texture &render_pass::add_resolve_texture(const std::string_view &name, c
 	return rt;
 }
 
+render_texture &render_pass::add_depth_resolve_texture(const std::string_view &name, const render_texture_info &info)
+{
+	m_written_textures.push_back(name);
+
+	render_texture &rt = m_render_graph.get_render_texture(name, info);
+	rt.m_usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	return rt;
+}
+
+render_texture &render_pass::add_sampled_texture(const std::string_view &name)
+{
+	m_read_textures.push_back(name);
+
+	render_texture &rt = m_render_graph.get_render_texture(name);
+	rt.m_usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	return rt;
+}
+
 render_texture &render_pass::add_transfer_src_texture(const std::string_view &name)
 {
 	m_read_textures.push_back(name);
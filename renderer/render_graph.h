@@ -88,6 +88,8 @@ public:
 	render_texture &add_color_texture(const std::string_view &name, const render_texture_info &info);
 	render_texture &add_depth_stencil_texture(const std::string_view &name, const render_texture_info &info);
 	render_texture &add_resolve_texture(const std::string_view &name, const render_texture_info &info);
+	render_texture &add_depth_resolve_texture(const std::string_view &name, const render_texture_info &info);
+	render_texture &add_sampled_texture(const std::string_view &name);
 	render_texture &add_transfer_src_texture(const std::string_view &name);
 	render_texture &add_transfer_dst_texture(const std::string_view &name, const render_texture_info &info);
 
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+
+#include <utils/util.h>
+
+#include "render_queue.h"
+
+static constexpr u32 depth_bits = 24;
+static constexpr u32 variant_bits = 8;
+static constexpr u32 part_bits = 16;
+static constexpr u32 object_bits = 12;
+static constexpr u32 layer_bits = 4;
+static_assert(depth_bits + variant_bits + part_bits + object_bits + layer_bits == 64, "Unexpected key size");
+
+static constexpr u32 variant_shift = depth_bits;
+static constexpr u32 part_shift = variant_shift + variant_bits;
+static constexpr u32 object_shift = part_shift + part_bits;
+static constexpr u32 layer_shift = object_shift + object_bits;
+
+static u64 mask(u32 value, u32 bits, const char *field)
+{
+	/* Truncated ids would give different objects equal keys, and batches would merge them. */
+	assert_if((u64)value >= (1ull << bits), "Draw key %s %u does not fit in %u bits", field, value, bits);
+	return value;
+}
+
+u64 make_draw_key(render_layer layer, u32 object, u32 part, u32 variant, float depth)
+{
+	constexpr float depth_max = (float)((1u << depth_bits) - 1);
+	depth = std::clamp(depth, 0.0f, 1.0f);
+	if (render_layer_transparent == layer)
+	{
+		depth = 1.0f - depth;
+	}
+
+	return (mask(layer, layer_bits, "layer") << layer_shift) | (mask(object, object_bits, "object") << object_shift) |
+	       (mask(part, part_bits, "part") << part_shift) | (mask(variant, variant_bits, "variant") << variant_shift) |
+	       mask((u32)std::lround(depth * depth_max), depth_bits, "depth");
+}
+
+u64 get_draw_state(u64 key)
+{
+	return key >> depth_bits;
+}
+
+render_layer get_draw_layer(u64 key)
+{
+	return (render_layer)(key >> layer_shift);
+}
+
+void radix_sort(std::vector<draw_packet> &packets, std::vector<draw_packet> &scratch)
+{
+	/* Histograms of all eight bytes in one pass. */
+	u32 counts[8][256] = {};
+	for (const draw_packet &packet : packets)
+	{
+		for (u32 byte = 0; byte < 8; ++byte)
+		{
+			++counts[byte][(packet.m_key >> (byte * 8)) & 0xff];
+		}
+	}
+
+	scratch.resize(packets.size());
+	for (u32 byte = 0; byte < 8; ++byte)
+	{
+		const u32 shift = byte * 8;
+		if (packets.empty() || counts[byte][(packets[0].m_key >> shift) & 0xff] == packets.size())
+		{
+			continue;
+		}
+
+		u32 offsets[256];
+		u32 offset = 0;
+		for (u32 bucket = 0; bucket < 256; ++bucket)
+		{
+			offsets[bucket] = offset;
+			offset += counts[byte][bucket];
+		}
+		for (const draw_packet &packet : packets)
+		{
+			scratch[offsets[(packet.m_key >> shift) & 0xff]++] = packet;
+		}
+		packets.swap(scratch);
+	}
+}
+
+void render_queue::clear()
+{
+	m_packets.clear();
+}
+
+void render_queue::push(u64 key, u32 type, u32 index)
+{
+	m_packets.push_back({ .m_key = key, .m_type = type, .m_index = index });
+}
+
+void render_queue::sort()
+{
+	radix_sort(m_packets, m_scratch);
+}
+
+std::span<const draw_packet> render_queue::get_layer(render_layer layer) const
+{
+	const auto begin = std::partition_point(m_packets.begin(), m_packets.end(), [&](const draw_packet &packet)
+	                                        { return get_draw_layer(packet.m_key) < layer; });
+	const auto end = std::partition_point(begin, m_packets.end(), [&](const draw_packet &packet)
+	                                      { return get_draw_layer(packet.m_key) == layer; });
+	return { begin, end };
+}
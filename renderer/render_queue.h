@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <utils/type.h>
+
+/* Draws are recorded layer by layer, in this order. */
+enum render_layer : u32
+{
+	render_layer_opaque = 0,
+	render_layer_sky = 1,
+	render_layer_transparent = 2,
+	render_layer_count = 3,
+};
+
+/* Builds a draw sort key. From most to least significant bits: layer (4), object (12), part (16), variant (8) and
+ * depth (24), e.g. a static model, its submesh and LOD. An object owns its pipeline and each part its material, so
+ * state changes are minimized first and equal state draws front to back. Depth is a normalized view distance in
+ * [0, 1], transparent draws invert it to draw back to front. Ids must fit in their fields, or it asserts. */
+u64 make_draw_key(render_layer layer, u32 object, u32 part, u32 variant, float depth);
+
+/* Key without the depth bits, equal for draws that share all state. */
+u64 get_draw_state(u64 key);
+
+render_layer get_draw_layer(u64 key);
+
+/* Compact reference to a draw, type and index are defined by whoever submits it. */
+struct draw_packet
+{
+	u64 m_key;
+	u32 m_type;
+	u32 m_index;
+};
+static_assert(sizeof(draw_packet) == 16, "Unexpected draw_packet size");
+
+/* Stable LSD radix sort on the 64-bit keys, bytes that are equal for all packets are skipped. */
+void radix_sort(std::vector<draw_packet> &packets, std::vector<draw_packet> &scratch);
+
+class render_queue
+{
+public:
+	render_queue() = default;
+	~render_queue() = default;
+
+	render_queue(const render_queue &) = delete;
+	render_queue operator=(const render_queue &) = delete;
+
+	void clear();
+	void push(u64 key, u32 type, u32 index);
+	void sort();
+
+	/* Sorted packets of one layer, valid after sort(). */
+	std::span<const draw_packet> get_layer(render_layer layer) const;
+
+	std::vector<draw_packet> m_packets = {};
+
+private:
+	std::vector<draw_packet> m_scratch = {};
+};
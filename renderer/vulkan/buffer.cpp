@@ -32,6 +32,11 @@ buffer &buffer::operator=(buffer &&o) noexcept
 {
 	if (this != &o)
 	{
+		if (VK_NULL_HANDLE != m_handle)
+		{
+			vmaDestroyBuffer(m_allocator, m_handle, m_allocation);
+		}
+
 		m_handle = o.m_handle;
 		m_size = o.m_size;
 		m_allocator = o.m_allocator;
@@ -63,11 +68,13 @@ void buffer::build(VmaAllocator allocator, VkBufferUsageFlags usage, VkDeviceSiz
 	    vmaCreateBuffer(allocator, &create_info, &alloc_create_info, &m_handle, &m_allocation, nullptr));
 }
 
-void buffer::fill(const void *data, size_t size)
+void buffer::fill(const void *data, size_t size, VkDeviceSize offset)
 {
+	assert_if(offset + size > m_size, "Buffer fill of %zu bytes at offset %lu overflows buffer", size, offset);
+
 	void *content = nullptr;
 	vmaMapMemory(m_allocator, m_allocation, &content);
-	memcpy(content, data, size);
+	memcpy((u8 *)content + offset, data, size);
 	vmaUnmapMemory(m_allocator, m_allocation);
 }
 
@@ -26,7 +26,7 @@ public:
 	buffer &operator=(buffer &&o) noexcept;
 
 	void build(VmaAllocator allocator, VkBufferUsageFlags usage, VkDeviceSize size);
-	void fill(const void *data, size_t size);
+	void fill(const void *data, size_t size, VkDeviceSize offset = 0);
 
 	VkBuffer m_handle = {};
 	VkDeviceSize m_size = 0;
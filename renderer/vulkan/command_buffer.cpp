@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+
 #include "command_buffer.h"
 #include "util.h"
 
@@ -40,12 +43,12 @@ command_buffer::~command_buffer()
 	}
 }
 
-void command_buffer::build(device &device, command_pool &command_pool)
+void command_buffer::build(device &device, command_pool &command_pool, VkCommandBufferLevel level)
 {
 	VkCommandBufferAllocateInfo alloc_info = {};
 	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	alloc_info.commandPool = command_pool.m_handle;
-	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.level = level;
 	alloc_info.commandBufferCount = 1;
 
 	VULKAN_ASSERT_SUCCESS(vkAllocateCommandBuffers(device.m_logical.m_handle, &alloc_info, &m_handle));
@@ -62,14 +65,18 @@ void command_buffer::reset()
 	}
 }
 
-void command_buffer::begin()
+void command_buffer::begin(const VkCommandBufferInheritanceInfo *inheritance_info)
 {
 	VkCommandBufferBeginInfo begin_info = {};
 	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	begin_info.flags = 0;
-	begin_info.pInheritanceInfo = nullptr;
+	begin_info.flags = inheritance_info ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0;
+	begin_info.pInheritanceInfo = inheritance_info;
 
 	VULKAN_ASSERT_SUCCESS(vkBeginCommandBuffer(m_handle, &begin_info));
+
+	m_pipeline_layout = nullptr;
+	m_statistics = {};
+	invalidate();
 }
 
 void command_buffer::end()
@@ -77,6 +84,77 @@ void command_buffer::end()
 	VULKAN_ASSERT_SUCCESS(vkEndCommandBuffer(m_handle));
 }
 
+void command_buffer::invalidate()
+{
+	m_bind_points = {};
+	m_vertex_buffers = {};
+	m_index_buffer = VK_NULL_HANDLE;
+	m_index_buffer_offset = 0;
+	m_index_type = VK_INDEX_TYPE_MAX_ENUM;
+	m_viewport.reset();
+	m_scissor.reset();
+	m_dynamic_states.clear();
+}
+
+command_buffer::bind_point_state &command_buffer::get_bind_point_state(VkPipelineBindPoint bind_point)
+{
+	assert_if((u32)bind_point >= m_bind_points.size(), "Unsupported pipeline bind point %u", bind_point);
+	return m_bind_points[(u32)bind_point];
+}
+
+command_buffer::bind_point_state &command_buffer::get_descriptor_state(VkPipelineBindPoint bind_point)
+{
+	bind_point_state &state = get_bind_point_state(bind_point);
+	if (state.descriptor_layout != m_pipeline_layout->m_handle)
+	{
+		/* Sets below the first incompatible one stay bound, pushed descriptors live in the last set. */
+		u32 compatible = 0;
+		while (compatible < max_tracked_sets && 0 != state.set_compatibility[compatible] &&
+		       state.set_compatibility[compatible] == m_pipeline_layout->m_set_compatibility[compatible])
+		{
+			++compatible;
+		}
+		if (compatible <= descriptor_set_draw)
+		{
+			state.descriptors = {};
+		}
+		std::fill(state.sets.begin() + compatible, state.sets.end(), VK_NULL_HANDLE);
+		state.descriptor_layout = m_pipeline_layout->m_handle;
+		state.set_compatibility = m_pipeline_layout->m_set_compatibility;
+	}
+	return state;
+}
+
+void command_buffer::push_descriptor(const VkWriteDescriptorSet &write, const pushed_descriptor &descriptor,
+                                     VkPipelineBindPoint bind_point)
+{
+	bind_point_state &state = get_descriptor_state(bind_point);
+	if (write.dstBinding < max_tracked_bindings)
+	{
+		if (state.descriptors[write.dstBinding] == descriptor)
+		{
+			++m_statistics.elided;
+			return;
+		}
+		state.descriptors[write.dstBinding] = descriptor;
+	}
+	vkCmdPushDescriptorSetKHR(m_handle, bind_point, m_pipeline_layout->m_handle, descriptor_set_draw, 1, &write);
+	++m_statistics.issued;
+}
+
+bool command_buffer::update_dynamic_state(VkDynamicState dynamic_state, u64 value)
+{
+	auto [it, inserted] = m_dynamic_states.try_emplace(dynamic_state, value);
+	if (!inserted && it->second == value)
+	{
+		++m_statistics.elided;
+		return false;
+	}
+	it->second = value;
+	++m_statistics.issued;
+	return true;
+}
+
 void command_buffer::transition_image_layout(image &image, VkImageLayout new_layout, VkPipelineStageFlagBits2 src_stage,
                                              VkAccessFlags2 src_access, VkPipelineStageFlagBits2 dst_stage,
                                              VkAccessFlags2 dst_access)
@@ -116,10 +194,115 @@ void command_buffer::transition_image_layout(image &image, VkImageLayout new_lay
 	image.m_layout = new_layout;
 }
 
+void command_buffer::memory_barrier(VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+                                    VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access)
+{
+	const VkMemoryBarrier2 memory_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.pNext = nullptr,
+		.srcStageMask = src_stage,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stage,
+		.dstAccessMask = dst_access,
+	};
+	const VkDependencyInfo dependency_info = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.pNext = nullptr,
+		.dependencyFlags = 0,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &memory_barrier,
+		.bufferMemoryBarrierCount = 0,
+		.pBufferMemoryBarriers = nullptr,
+		.imageMemoryBarrierCount = 0,
+		.pImageMemoryBarriers = nullptr,
+	};
+	vkCmdPipelineBarrier2(m_handle, &dependency_info);
+}
+
 void command_buffer::bind_pipeline(const pipeline &pipeline, VkPipelineBindPoint bind_point)
 {
-	m_pipeline = &pipeline;
-	vkCmdBindPipeline(m_handle, bind_point, pipeline.m_handle);
+	m_pipeline_layout = &pipeline.m_pipeline_layout;
+
+	bind_point_state &state = get_bind_point_state(bind_point);
+	if (m_shader_objects && pipeline.has_shader_objects())
+	{
+		/* Pipelines sharing a VkPipeline may not share state while an update is pending. */
+		if (VK_NULL_HANDLE == state.pipeline && state.graphics_pipeline == &pipeline)
+		{
+			++m_statistics.elided;
+			return;
+		}
+		state.pipeline = VK_NULL_HANDLE;
+		state.graphics_pipeline = &pipeline;
+		pipeline.bind_shader_objects(*this);
+		++m_statistics.issued;
+		return;
+	}
+
+	if (state.pipeline == pipeline.m_handle && state.graphics_pipeline == &pipeline)
+	{
+		++m_statistics.elided;
+		return;
+	}
+
+	/* Pipelines that only differ in dynamic state share their VkPipeline, only the dynamic state is set. */
+	if (state.pipeline != pipeline.m_handle)
+	{
+		state.pipeline = pipeline.m_handle;
+		vkCmdBindPipeline(m_handle, bind_point, pipeline.m_handle);
+		++m_statistics.issued;
+
+		/* State the VkPipeline bakes in overwrites what was set dynamically. */
+		std::erase_if(m_dynamic_states, [&](const auto &dynamic_state)
+		              { return !pipeline.has_dynamic_state(dynamic_state.first); });
+	}
+	state.graphics_pipeline = &pipeline;
+	pipeline.set_dynamic_state(*this);
+}
+
+void command_buffer::bind_pipeline(const compute_pipeline &pipeline)
+{
+	m_pipeline_layout = &pipeline.m_pipeline_layout;
+
+	bind_point_state &state = get_bind_point_state(VK_PIPELINE_BIND_POINT_COMPUTE);
+	if (state.pipeline == pipeline.m_handle)
+	{
+		++m_statistics.elided;
+		return;
+	}
+	state.pipeline = pipeline.m_handle;
+	vkCmdBindPipeline(m_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.m_handle);
+	++m_statistics.issued;
+}
+
+void command_buffer::bind_vertex_buffer(u32 binding, const buffer &buffer, VkDeviceSize offset)
+{
+	if (binding < max_tracked_bindings)
+	{
+		const vertex_binding vertex_buffer = { .buffer = buffer.m_handle, .offset = offset };
+		if (m_vertex_buffers[binding] == vertex_buffer)
+		{
+			++m_statistics.elided;
+			return;
+		}
+		m_vertex_buffers[binding] = vertex_buffer;
+	}
+	vkCmdBindVertexBuffers(m_handle, binding, 1, &buffer.m_handle, &offset);
+	++m_statistics.issued;
+}
+
+void command_buffer::bind_index_buffer(const buffer &buffer, VkDeviceSize offset, VkIndexType index_type)
+{
+	if (m_index_buffer == buffer.m_handle && m_index_buffer_offset == offset && m_index_type == index_type)
+	{
+		++m_statistics.elided;
+		return;
+	}
+	m_index_buffer = buffer.m_handle;
+	m_index_buffer_offset = offset;
+	m_index_type = index_type;
+	vkCmdBindIndexBuffer(m_handle, buffer.m_handle, offset, index_type);
+	++m_statistics.issued;
 }
 
 void command_buffer::set_uniform_buffer(u32 binding, const buffer &buffer, VkPipelineBindPoint bind_point)
@@ -138,7 +321,7 @@ void command_buffer::set_uniform_buffer(u32 binding, const buffer &buffer, VkPip
 	write.descriptorCount = 1;
 	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	write.pBufferInfo = &buffer_info;
-	vkCmdPushDescriptorSetKHR(m_handle, bind_point, m_pipeline->m_pipeline_layout.m_handle, 0, 1, &write);
+	push_descriptor(write, { .type = write.descriptorType, .resource = (u64)buffer.m_handle }, bind_point);
 }
 
 void command_buffer::set_texture(u32 binding, const texture &texture, VkPipelineBindPoint bind_point)
@@ -157,7 +340,191 @@ void command_buffer::set_texture(u32 binding, const texture &texture, VkPipeline
 	write.descriptorCount = 1;
 	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	write.pImageInfo = &image_info;
-	vkCmdPushDescriptorSetKHR(m_handle, bind_point, m_pipeline->m_pipeline_layout.m_handle, 0, 1, &write);
+	push_descriptor(write,
+	                { .type = write.descriptorType,
+	                  .resource = (u64)image_info.imageView,
+	                  .sampler = image_info.sampler,
+	                  .layout = image_info.imageLayout },
+	                bind_point);
+}
+
+void command_buffer::set_storage_buffer(u32 binding, const buffer &buffer, VkPipelineBindPoint bind_point)
+{
+	VkDescriptorBufferInfo buffer_info = {};
+	buffer_info.buffer = buffer.m_handle;
+	buffer_info.offset = 0;
+	buffer_info.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = 0;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &buffer_info;
+	push_descriptor(write, { .type = write.descriptorType, .resource = (u64)buffer.m_handle }, bind_point);
+}
+
+void command_buffer::set_sampled_image(u32 binding, const image_view &image_view, VkSampler sampler,
+                                       VkPipelineBindPoint bind_point)
+{
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = sampler;
+	image_info.imageView = image_view.m_handle;
+	image_info.imageLayout = image_view.m_image->m_layout;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = 0;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	push_descriptor(write,
+	                { .type = write.descriptorType,
+	                  .resource = (u64)image_info.imageView,
+	                  .sampler = image_info.sampler,
+	                  .layout = image_info.imageLayout },
+	                bind_point);
+}
+
+void command_buffer::set_storage_image(u32 binding, const image_view &image_view, VkPipelineBindPoint bind_point)
+{
+	assert_if(VK_IMAGE_LAYOUT_GENERAL != image_view.m_image->m_layout, "Storage images must be in GENERAL layout");
+
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = VK_NULL_HANDLE;
+	image_info.imageView = image_view.m_handle;
+	image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = 0;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	write.pImageInfo = &image_info;
+	push_descriptor(write,
+	                { .type = write.descriptorType,
+	                  .resource = (u64)image_info.imageView,
+	                  .sampler = image_info.sampler,
+	                  .layout = image_info.imageLayout },
+	                bind_point);
+}
+
+void command_buffer::set_separate_image(u32 binding, const image_view &image_view, VkPipelineBindPoint bind_point)
+{
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = VK_NULL_HANDLE;
+	image_info.imageView = image_view.m_handle;
+	image_info.imageLayout = image_view.m_image->m_layout;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = 0;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	write.pImageInfo = &image_info;
+	push_descriptor(write,
+	                { .type = write.descriptorType,
+	                  .resource = (u64)image_info.imageView,
+	                  .sampler = image_info.sampler,
+	                  .layout = image_info.imageLayout },
+	                bind_point);
+}
+
+void command_buffer::set_sampler(u32 binding, VkSampler sampler, VkPipelineBindPoint bind_point)
+{
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = sampler;
+	image_info.imageView = VK_NULL_HANDLE;
+	image_info.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = 0;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	write.pImageInfo = &image_info;
+	push_descriptor(write, { .type = write.descriptorType, .sampler = image_info.sampler }, bind_point);
+}
+
+void command_buffer::bind_descriptor_set(u32 set, VkDescriptorSet descriptor_set, VkPipelineBindPoint bind_point)
+{
+	bind_point_state &state = get_descriptor_state(bind_point);
+	if (set < max_tracked_sets)
+	{
+		if (state.sets[set] == descriptor_set)
+		{
+			++m_statistics.elided;
+			return;
+		}
+		state.sets[set] = descriptor_set;
+	}
+	vkCmdBindDescriptorSets(m_handle, bind_point, m_pipeline_layout->m_handle, set, 1, &descriptor_set, 0, nullptr);
+	++m_statistics.issued;
+}
+
+void command_buffer::set_viewport(const VkViewport &viewport)
+{
+	if (m_viewport && 0 == std::memcmp(&*m_viewport, &viewport, sizeof(viewport)))
+	{
+		++m_statistics.elided;
+		return;
+	}
+	m_viewport = viewport;
+	vkCmdSetViewportWithCount(m_handle, 1, &viewport);
+	++m_statistics.issued;
+}
+
+void command_buffer::set_scissor(const VkRect2D &scissor)
+{
+	if (m_scissor && 0 == std::memcmp(&*m_scissor, &scissor, sizeof(scissor)))
+	{
+		++m_statistics.elided;
+		return;
+	}
+	m_scissor = scissor;
+	vkCmdSetScissorWithCount(m_handle, 1, &scissor);
+	++m_statistics.issued;
+}
+
+void command_buffer::dispatch(u32 group_count_x, u32 group_count_y, u32 group_count_z)
+{
+	vkCmdDispatch(m_handle, group_count_x, group_count_y, group_count_z);
+	++m_statistics.issued;
+}
+
+void command_buffer::dispatch_indirect(const buffer &buffer, VkDeviceSize offset)
+{
+	assert_if(offset % 4 != 0 || offset + sizeof(VkDispatchIndirectCommand) > buffer.m_size,
+	          "Indirect dispatch out of buffer bounds");
+	vkCmdDispatchIndirect(m_handle, buffer.m_handle, offset);
+	++m_statistics.issued;
+}
+
+void command_buffer::set_shader_objects(bool enable)
+{
+	m_shader_objects = enable;
+}
+
+void command_buffer::execute_commands(const command_buffer &secondary)
+{
+	vkCmdExecuteCommands(m_handle, 1, &secondary.m_handle);
+	++m_statistics.issued;
+	invalidate();
 }
 
 } /* namespace vulkan */
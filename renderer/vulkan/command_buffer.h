@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <optional>
+#include <unordered_map>
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Weverything"
 #include <third_party/volk/volk.h>
@@ -31,6 +35,13 @@ private:
 	VkDevice m_device_handle = {};
 };
 
+/* Commands recorded through command_buffer, reset on begin(). Elided commands were dropped as redundant. */
+struct command_statistics
+{
+	u32 issued;
+	u32 elided;
+};
+
 class command_buffer
 {
 public:
@@ -40,23 +51,112 @@ public:
 	command_buffer(const command_buffer &) = delete;
 	command_buffer operator=(const command_buffer &) = delete;
 
-	void build(device &device, command_pool &command_pool);
+	void build(device &device, command_pool &command_pool,
+	           VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	void reset();
-	void begin();
+
+	/* Secondary command buffers executed inside rendering pass the inheritance info of that rendering. */
+	void begin(const VkCommandBufferInheritanceInfo *inheritance_info = nullptr);
 	void end();
+
+	/* Forgets all tracked state, must be called after recording commands that bypass command_buffer. */
+	void invalidate();
+
 	void transition_image_layout(image &image, VkImageLayout new_layout, VkPipelineStageFlagBits2 src_stage,
 	                             VkAccessFlags2 src_access, VkPipelineStageFlagBits2 dst_stage,
 	                             VkAccessFlags2 dst_access);
+	void memory_barrier(VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage,
+	                    VkAccessFlags2 dst_access);
 	void bind_pipeline(const pipeline &pipeline, VkPipelineBindPoint bind_point);
+	void bind_pipeline(const compute_pipeline &pipeline);
+	void bind_vertex_buffer(u32 binding, const buffer &buffer, VkDeviceSize offset);
+	void bind_index_buffer(const buffer &buffer, VkDeviceSize offset, VkIndexType index_type);
 	void set_uniform_buffer(u32 binding, const buffer &buffer, VkPipelineBindPoint bind_point);
 	void set_texture(u32 binding, const texture &texture, VkPipelineBindPoint bind_point);
+	void set_storage_buffer(u32 binding, const buffer &buffer, VkPipelineBindPoint bind_point);
+	void set_sampled_image(u32 binding, const image_view &image_view, VkSampler sampler,
+	                       VkPipelineBindPoint bind_point);
+	void set_storage_image(u32 binding, const image_view &image_view, VkPipelineBindPoint bind_point);
+	/* Separate images and samplers, for shaders that combine them themselves. */
+	void set_separate_image(u32 binding, const image_view &image_view, VkPipelineBindPoint bind_point);
+	void set_sampler(u32 binding, VkSampler sampler, VkPipelineBindPoint bind_point);
+	void bind_descriptor_set(u32 set, VkDescriptorSet descriptor_set, VkPipelineBindPoint bind_point);
+	void set_viewport(const VkViewport &viewport);
+	void set_scissor(const VkRect2D &scissor);
+	void dispatch(u32 group_count_x, u32 group_count_y, u32 group_count_z);
+	/* Reads a VkDispatchIndirectCommand at offset, the buffer needs VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT. */
+	void dispatch_indirect(const buffer &buffer, VkDeviceSize offset);
+
+	/* Graphics pipelines with shader objects are bound as shader objects and dynamic state from then on. */
+	void set_shader_objects(bool enable);
+
+	/* State is undefined after executing secondary command buffers, all tracked state is invalidated. */
+	void execute_commands(const command_buffer &secondary);
 
 	VkCommandBuffer m_handle = {};
+	command_statistics m_statistics = {};
 
 private:
+	friend class pipeline;
+
+	/* Resource last pushed to a descriptor_set_draw binding, buffers are always pushed whole. */
+	struct pushed_descriptor
+	{
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+		u64 resource = 0;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		bool operator==(const pushed_descriptor &) const = default;
+	};
+
+	struct vertex_binding
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+
+		bool operator==(const vertex_binding &) const = default;
+	};
+
+	static constexpr u32 max_tracked_bindings = 8;
+	static constexpr u32 max_tracked_sets = descriptor_set_count;
+
+	/* Descriptors are tracked for the pipeline layout they were last recorded with. A different layout only disturbs
+	 * the sets from the first one it is incompatible with. */
+	struct bind_point_state
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		/* Graphics pipeline whose shader objects or dynamic state were last set. */
+		const pipeline *graphics_pipeline = nullptr;
+		VkPipelineLayout descriptor_layout = VK_NULL_HANDLE;
+		std::array<u64, max_tracked_sets> set_compatibility = {};
+		std::array<pushed_descriptor, max_tracked_bindings> descriptors = {};
+		std::array<VkDescriptorSet, max_tracked_sets> sets = {};
+	};
+
+	bind_point_state &get_bind_point_state(VkPipelineBindPoint bind_point);
+	bind_point_state &get_descriptor_state(VkPipelineBindPoint bind_point);
+	void push_descriptor(const VkWriteDescriptorSet &write, const pushed_descriptor &descriptor,
+	                     VkPipelineBindPoint bind_point);
+
+	/* Records the value of a dynamic state, see pipeline::get_state. Returns false if it was already set to it, in
+	 * which case the vkCmdSet* call is skipped. */
+	bool update_dynamic_state(VkDynamicState dynamic_state, u64 value);
+
 	VkDevice m_device_handle = {};
 	VkCommandPool m_command_pool_handle = {};
-	const pipeline *m_pipeline = nullptr;
+	const pipeline_layout *m_pipeline_layout = nullptr;
+	bool m_shader_objects = false;
+
+	/* Bound state, identical rebinds are skipped. */
+	std::array<bind_point_state, 2> m_bind_points = {};
+	std::array<vertex_binding, max_tracked_bindings> m_vertex_buffers = {};
+	VkBuffer m_index_buffer = VK_NULL_HANDLE;
+	VkDeviceSize m_index_buffer_offset = 0;
+	VkIndexType m_index_type = VK_INDEX_TYPE_MAX_ENUM;
+	std::optional<VkViewport> m_viewport = {};
+	std::optional<VkRect2D> m_scissor = {};
+	std::unordered_map<VkDynamicState, u64> m_dynamic_states = {};
 };
 
 } /* namespace vulkan */
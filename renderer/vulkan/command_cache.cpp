@@ -0,0 +1,60 @@
+#include "command_cache.h"
+
+namespace vulkan
+{
+
+void command_cache::build(device &device)
+{
+	m_command_pool.build(device);
+	m_command_buffer.build(device, m_command_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+	m_valid = false;
+}
+
+void command_cache::invalidate()
+{
+	m_valid = false;
+}
+
+void command_cache::execute(command_buffer &command_buffer, const rendering_formats &formats,
+                            const std::function<void(vulkan::command_buffer &)> &record)
+{
+	/* Frames are waited on before the next one is recorded, so the previous recording is no longer in use. */
+	const bool formats_changed = m_formats.color_format != formats.color_format ||
+	                             m_formats.depth_format != formats.depth_format ||
+	                             m_formats.sample_count != formats.sample_count;
+	if (!m_valid || formats_changed)
+	{
+		const VkCommandBufferInheritanceRenderingInfo rendering_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO, //
+			.pNext = nullptr,                                                     //
+			.flags = 0,                                                           //
+			.viewMask = 0,                                                        //
+			.colorAttachmentCount = 1,                                            //
+			.pColorAttachmentFormats = &formats.color_format,                     //
+			.depthAttachmentFormat = formats.depth_format,                        //
+			.stencilAttachmentFormat = VK_FORMAT_UNDEFINED,                       //
+			.rasterizationSamples = formats.sample_count,                         //
+		};
+		const VkCommandBufferInheritanceInfo inheritance_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, //
+			.pNext = &rendering_info,                                   //
+			.renderPass = VK_NULL_HANDLE,                               //
+			.subpass = 0,                                               //
+			.framebuffer = VK_NULL_HANDLE,                              //
+			.occlusionQueryEnable = VK_FALSE,                           //
+			.queryFlags = 0,                                            //
+			.pipelineStatistics = 0,                                    //
+		};
+
+		m_command_buffer.begin(&inheritance_info);
+		record(m_command_buffer);
+		m_command_buffer.end();
+		m_formats = formats;
+		m_valid = true;
+		++m_record_count;
+	}
+
+	command_buffer.execute_commands(m_command_buffer);
+}
+
+} /* namespace vulkan */
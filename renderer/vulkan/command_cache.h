@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <third_party/volk/volk.h>
+#pragma clang diagnostic pop
+
+#include <utils/type.h>
+
+#include "command_buffer.h"
+#include "device.h"
+
+namespace vulkan
+{
+
+/* Attachments of the rendering cached commands are executed in. */
+struct rendering_formats
+{
+	VkFormat color_format;
+	VkFormat depth_format;
+	VkSampleCountFlagBits sample_count;
+};
+
+/* Secondary command buffer that is recorded once and executed every frame until it is invalidated. Its owner must
+ * invalidate it whenever anything the recorded commands depend on changes, e.g. pipeline or buffer handles and dynamic
+ * state. Rendering formats are part of the inheritance info and are compared by execute. */
+class command_cache
+{
+public:
+	command_cache() = default;
+	~command_cache() = default;
+
+	command_cache(const command_cache &) = delete;
+	command_cache operator=(const command_cache &) = delete;
+
+	void build(device &device);
+	void invalidate();
+
+	/* Re-records with record if invalidated or the formats changed, then executes in command_buffer. Rendering must
+	 * have been begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT and the given formats. */
+	void execute(command_buffer &command_buffer, const rendering_formats &formats,
+	             const std::function<void(vulkan::command_buffer &)> &record);
+
+	u32 m_record_count = 0;
+
+private:
+	/* Own pool, the frame command pool is reset every frame. */
+	command_pool m_command_pool = {};
+	vulkan::command_buffer m_command_buffer = {};
+	rendering_formats m_formats = {};
+	bool m_valid = false;
+};
+
+} /* namespace vulkan */
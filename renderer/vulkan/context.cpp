@@ -61,8 +61,14 @@ void context::build()
 	m_wsi.build_swapchain(m_device);
 	m_queue.build(m_device);
 
+	/* Pipeline cache initialization, saved again when the context is destroyed. */
+	m_pipeline_cache.build(m_device, "bin/pipeline_cache.bin");
+	m_device.m_pipeline_cache = m_pipeline_cache.m_handle;
+	m_device.m_pipeline_registry = &m_pipeline_registry;
+
 	/* Resource management initialization. */
 	m_resource_allocator.build(m_instance, m_device);
+	m_bindless_table.build(m_device);
 	m_command_pool.build(m_device);
 	m_command_buffer.build(m_device, m_command_pool);
 	m_image_available_semaphore.build(m_device);
@@ -10,8 +10,11 @@
 #include <platform/window.h>
 #include <utils/type.h>
 
+#include "descriptor_set.h"
 #include "device.h"
 #include "instance.h"
+#include "pipeline_cache.h"
+#include "pipeline_registry.h"
 #include "queue.h"
 #include "resource_allocator.h"
 #include "wsi.h"
@@ -39,9 +42,12 @@ public:
 	glfw_window m_window = {};
 	instance m_instance = {};
 	device m_device = {};
+	pipeline_cache m_pipeline_cache = {};
+	pipeline_registry m_pipeline_registry = {};
 	wsi m_wsi = {};
 	queue m_queue = {};
 	resource_allocator m_resource_allocator = {};
+	bindless_table m_bindless_table = {};
 
 	command_pool m_command_pool = {};
 	command_buffer m_command_buffer = {};
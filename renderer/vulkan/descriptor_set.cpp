@@ -1,4 +1,11 @@
+#include <algorithm>
+
+#include <utils/util.h>
+
+#include "buffer.h"
+#include "command_buffer.h"
 #include "descriptor_set.h"
+#include "image.h"
 #include "util.h"
 
 namespace vulkan
@@ -12,37 +19,261 @@ descriptor_set_layout::~descriptor_set_layout()
 	}
 }
 
-void descriptor_set_layout::add_binding(u32 binding, VkDescriptorType type)
+void descriptor_set_layout::add_binding(u32 binding, VkDescriptorType type, u32 count, VkDescriptorBindingFlags flags,
+                                        VkShaderStageFlags stages)
 {
 	VkDescriptorSetLayoutBinding dsl_binding = {};
 	dsl_binding.binding = binding;
 	dsl_binding.descriptorType = type;
-	dsl_binding.descriptorCount = 1;              /* (TODO, thoave01): No arrays. */
-	dsl_binding.stageFlags = VK_SHADER_STAGE_ALL; /* (TODO, thoave01): What's the overhead? */
+	dsl_binding.descriptorCount = count;
+	dsl_binding.stageFlags = stages;
 	dsl_binding.pImmutableSamplers = nullptr;
 	m_bindings.push_back(dsl_binding);
+	m_binding_flags.push_back(flags);
 }
 
-void descriptor_set_layout::build(device &device)
+void descriptor_set_layout::build(device &device, VkDescriptorSetLayoutCreateFlags flags)
 {
 	m_device_handle = device.m_logical.m_handle;
+
+	/* Binding flags are only chained when used, plain push descriptor layouts stay as they were. */
+	const VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO, //
+		.pNext = nullptr,                                                           //
+		.bindingCount = (u32)m_binding_flags.size(),                                //
+		.pBindingFlags = m_binding_flags.data(),                                    //
+	};
+	const bool has_binding_flags =
+	    std::any_of(m_binding_flags.begin(), m_binding_flags.end(), [](VkDescriptorBindingFlags f) { return f != 0; });
+
 	VkDescriptorSetLayoutCreateInfo create_info = {
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,     //
-		.pNext = nullptr,                                                 //
-		.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR, //
-		.bindingCount = (u32)m_bindings.size(),                           //
-		.pBindings = m_bindings.data(),                                   //
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, //
+		.pNext = has_binding_flags ? &binding_flags_info : nullptr,   //
+		.flags = flags,                                               //
+		.bindingCount = (u32)m_bindings.size(),                       //
+		.pBindings = m_bindings.data(),                               //
 	};
 	VULKAN_ASSERT_SUCCESS(vkCreateDescriptorSetLayout(m_device_handle, &create_info, nullptr, &m_handle));
+
+	m_hash = hash_combine(0, flags);
+	for (size_t i = 0; i < m_bindings.size(); ++i)
+	{
+		m_hash = hash_combine(m_hash, m_bindings[i].binding);
+		m_hash = hash_combine(m_hash, m_bindings[i].descriptorType);
+		m_hash = hash_combine(m_hash, m_bindings[i].descriptorCount);
+		m_hash = hash_combine(m_hash, m_bindings[i].stageFlags);
+		m_hash = hash_combine(m_hash, m_binding_flags[i]);
+	}
 }
 
 descriptor_set::~descriptor_set()
 {
+	if (VK_NULL_HANDLE != m_pool)
+	{
+		/* Frees m_handle as well. */
+		vkDestroyDescriptorPool(m_device_handle, m_pool, nullptr);
+	}
+}
+
+void descriptor_set::add_binding(u32 binding, VkDescriptorType type)
+{
+	/* Same definition as pipeline_layout::build gives the set, see descriptor_set_layout::m_hash. */
+	m_layout.add_binding(binding, type);
+
+	const auto pool_size = std::find_if(m_pool_sizes.begin(), m_pool_sizes.end(),
+	                                    [&](const VkDescriptorPoolSize &size) { return size.type == type; });
+	if (pool_size != m_pool_sizes.end())
+	{
+		++pool_size->descriptorCount;
+	}
+	else
+	{
+		m_pool_sizes.push_back({ .type = type, .descriptorCount = 1 });
+	}
 }
 
 void descriptor_set::build(device &device)
 {
 	m_device_handle = device.m_logical.m_handle;
+
+	m_layout.build(device, 0);
+
+	const VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, //
+		.pNext = nullptr,                                       //
+		.flags = 0,                                             //
+		.maxSets = 1,                                           //
+		.poolSizeCount = (u32)m_pool_sizes.size(),              //
+		.pPoolSizes = m_pool_sizes.data(),                      //
+	};
+	VULKAN_ASSERT_SUCCESS(vkCreateDescriptorPool(m_device_handle, &pool_info, nullptr, &m_pool));
+
+	const VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, //
+		.pNext = nullptr,                                        //
+		.descriptorPool = m_pool,                                //
+		.descriptorSetCount = 1,                                 //
+		.pSetLayouts = &m_layout.m_handle,                       //
+	};
+	VULKAN_ASSERT_SUCCESS(vkAllocateDescriptorSets(m_device_handle, &allocate_info, &m_handle));
+}
+
+void descriptor_set::write_buffer(u32 binding, VkDescriptorType type, const buffer &buffer)
+{
+	VkDescriptorBufferInfo buffer_info = {};
+	buffer_info.buffer = buffer.m_handle;
+	buffer_info.offset = 0;
+	buffer_info.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = m_handle;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(m_device_handle, 1, &write, 0, nullptr);
+}
+
+void descriptor_set::write_uniform_buffer(u32 binding, const buffer &buffer)
+{
+	write_buffer(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer);
+}
+
+void descriptor_set::write_storage_buffer(u32 binding, const buffer &buffer)
+{
+	write_buffer(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer);
+}
+
+void descriptor_set::write_texture(u32 binding, const texture &texture)
+{
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = texture.m_sampler;
+	image_info.imageView = texture.m_image_view.m_handle;
+	image_info.imageLayout = texture.m_image.m_layout;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = m_handle;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(m_device_handle, 1, &write, 0, nullptr);
+}
+
+void descriptor_set::bind(command_buffer &command_buffer, u32 set, VkPipelineBindPoint bind_point) const
+{
+	assert_if(bindless_table::set_index == set || descriptor_set_draw == set, "Set %u is not written up front", set);
+	command_buffer.bind_descriptor_set(set, m_handle, bind_point);
+}
+
+bindless_table::~bindless_table()
+{
+	if (VK_NULL_HANDLE != m_pool)
+	{
+		/* Frees m_set as well. */
+		vkDestroyDescriptorPool(m_device_handle, m_pool, nullptr);
+	}
+}
+
+void bindless_table::build_layout(device &device, descriptor_set_layout &layout)
+{
+	/* Arrays are written while command buffers using them may be recorded, and only the used prefix is valid. All
+	 * stages are kept, so that every pipeline defines the table identically whichever stages sample it. */
+	constexpr VkDescriptorBindingFlags flags =
+	    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+	layout.add_binding(texture_2d_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity, flags);
+	layout.add_binding(texture_cube_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity, flags);
+	layout.build(device, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+}
+
+void bindless_table::build(device &device)
+{
+	m_device_handle = device.m_logical.m_handle;
+
+	build_layout(device, m_layout);
+
+	const VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, //
+		.descriptorCount = 2 * capacity,                   //
+	};
+	const VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,   //
+		.pNext = nullptr,                                         //
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT, //
+		.maxSets = 1,                                             //
+		.poolSizeCount = 1,                                       //
+		.pPoolSizes = &pool_size,                                 //
+	};
+	VULKAN_ASSERT_SUCCESS(vkCreateDescriptorPool(m_device_handle, &pool_info, nullptr, &m_pool));
+
+	const VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, //
+		.pNext = nullptr,                                        //
+		.descriptorPool = m_pool,                                //
+		.descriptorSetCount = 1,                                 //
+		.pSetLayouts = &m_layout.m_handle,                       //
+	};
+	VULKAN_ASSERT_SUCCESS(vkAllocateDescriptorSets(m_device_handle, &allocate_info, &m_set));
+}
+
+u32 bindless_table::add_texture(texture &texture)
+{
+	assert_if(nullptr != texture.m_bindless_table, "Texture is already in a bindless table");
+
+	/* Released elements are reused first, their previous textures are no longer sampled. */
+	const bool cube = texture.m_image.m_info.m_layers != 1;
+	u32 &count = cube ? m_texture_cube_count : m_texture_2d_count;
+	std::vector<u32> &free_indices = cube ? m_free_texture_cube_indices : m_free_texture_2d_indices;
+	u32 index = count;
+	if (!free_indices.empty())
+	{
+		index = free_indices.back();
+		free_indices.pop_back();
+	}
+	else
+	{
+		assert_if(count >= capacity, "Bindless table is full");
+		++count;
+	}
+
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = texture.m_sampler;
+	image_info.imageView = texture.m_image_view.m_handle;
+	image_info.imageLayout = texture.m_image.m_layout;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = m_set;
+	write.dstBinding = cube ? texture_cube_binding : texture_2d_binding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(m_device_handle, 1, &write, 0, nullptr);
+
+	texture.m_bindless_table = this;
+	texture.m_bindless_index = index;
+	return index;
+}
+
+void bindless_table::remove_texture(const texture &texture)
+{
+	/* The stale descriptor stays written, partially bound arrays may hold descriptors that are never sampled. */
+	const bool cube = texture.m_image.m_info.m_layers != 1;
+	std::vector<u32> &free_indices = cube ? m_free_texture_cube_indices : m_free_texture_2d_indices;
+	free_indices.push_back(texture.m_bindless_index);
+}
+
+void bindless_table::bind(command_buffer &command_buffer, VkPipelineBindPoint bind_point) const
+{
+	command_buffer.bind_descriptor_set(set_index, m_set, bind_point);
 }
 
 } /* namespace vulkan */
@@ -12,6 +12,22 @@
 namespace vulkan
 {
 
+class buffer;
+class command_buffer;
+class texture;
+
+/* Descriptor sets by update frequency, from the least to the most frequently changed so that rebinding a set leaves
+ * the ones below it bound. The bindless table lives for the whole frame, pass and material sets are written up front
+ * and bound by their owners, and per-draw resources are pushed to the last set. */
+enum descriptor_set_index : u32
+{
+	descriptor_set_frame = 0,
+	descriptor_set_pass = 1,
+	descriptor_set_material = 2,
+	descriptor_set_draw = 3,
+	descriptor_set_count = 4,
+};
+
 class descriptor_set_layout
 {
 public:
@@ -21,16 +37,23 @@ public:
 	descriptor_set_layout(const descriptor_set_layout &) = delete;
 	descriptor_set_layout operator=(const descriptor_set_layout &) = delete;
 
-	void add_binding(u32 binding, VkDescriptorType type);
-	void build(device &device);
+	void add_binding(u32 binding, VkDescriptorType type, u32 count = 1, VkDescriptorBindingFlags flags = 0,
+	                 VkShaderStageFlags stages = VK_SHADER_STAGE_ALL);
+	void build(device &device,
+	           VkDescriptorSetLayoutCreateFlags flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
 
 	VkDescriptorSetLayout m_handle = {};
+	/* Equal for identically defined layouts, valid after build(). */
+	u64 m_hash = 0;
 
 private:
 	VkDevice m_device_handle = {};
 	std::vector<VkDescriptorSetLayoutBinding> m_bindings = {};
+	std::vector<VkDescriptorBindingFlags> m_binding_flags = {};
 };
 
+/* Set written once and bound by its owner, for the pass and material sets. Pipeline layouts define these sets for all
+ * stages, so a set built with the same bindings is compatible with every pipeline using them. */
 class descriptor_set
 {
 public:
@@ -40,10 +63,66 @@ public:
 	descriptor_set(const descriptor_set &) = delete;
 	descriptor_set operator=(const descriptor_set &) = delete;
 
+	/* Bindings are added in increasing order, as declared by the shaders using the set. */
+	void add_binding(u32 binding, VkDescriptorType type);
 	void build(device &device);
 
+	/* Resources must outlive any draw that binds the set, buffers are written whole. */
+	void write_uniform_buffer(u32 binding, const buffer &buffer);
+	void write_storage_buffer(u32 binding, const buffer &buffer);
+	void write_texture(u32 binding, const texture &texture);
+
+	void bind(command_buffer &command_buffer, u32 set, VkPipelineBindPoint bind_point) const;
+
+	descriptor_set_layout m_layout = {};
+	VkDescriptorPool m_pool = {};
 	VkDescriptorSet m_handle = {};
 
+private:
+	void write_buffer(u32 binding, VkDescriptorType type, const buffer &buffer);
+
+	VkDevice m_device_handle = {};
+	std::vector<VkDescriptorPoolSize> m_pool_sizes = {};
+};
+
+/* Global table of sampled textures, bound once at set_index and indexed by shaders through per-draw data instead of
+ * pushing a descriptor per draw. 2D and cube textures live in separate arrays. */
+class bindless_table
+{
+public:
+	bindless_table() = default;
+	~bindless_table();
+
+	bindless_table(const bindless_table &) = delete;
+	bindless_table operator=(const bindless_table &) = delete;
+
+	static constexpr u32 set_index = descriptor_set_frame;
+	static constexpr u32 texture_2d_binding = 0;
+	static constexpr u32 texture_cube_binding = 1;
+	static constexpr u32 capacity = 4096; /* Per array. */
+
+	/* Pipeline layouts using set_index must build it with this, so that they are compatible with the table. */
+	static void build_layout(device &device, descriptor_set_layout &layout);
+
+	void build(device &device);
+
+	/* Writes the texture to a free element of its array and returns the index shaders use to sample it. The texture
+	 * must already be in its shader read layout and outlive any draw that samples it. */
+	u32 add_texture(texture &texture);
+
+	/* Called by the texture destructor, the element is reused by the next texture added to its array. */
+	void remove_texture(const texture &texture);
+
+	void bind(command_buffer &command_buffer, VkPipelineBindPoint bind_point) const;
+
+	descriptor_set_layout m_layout = {};
+	VkDescriptorPool m_pool = {};
+	VkDescriptorSet m_set = {};
+	u32 m_texture_2d_count = 0; /* Elements written so far, including released ones. */
+	u32 m_texture_cube_count = 0;
+	std::vector<u32> m_free_texture_2d_indices = {};
+	std::vector<u32> m_free_texture_cube_indices = {};
+
 private:
 	VkDevice m_device_handle = {};
 };
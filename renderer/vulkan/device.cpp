@@ -169,8 +169,161 @@ void device::create_logical_device(instance &instance, const VpProfileProperties
 	float queue_priority = 1.0f;
 	queue_create_info.pQueuePriorities = &queue_priority;
 
+	/* Optional features on top of the profile. */
+	VkPhysicalDeviceMeshShaderFeaturesEXT supported_mesh_shader_features = {};
+	supported_mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	const bool mesh_shader_extension =
+	    physical_device_has_required_extensions(m_physical.m_handle, { VK_EXT_MESH_SHADER_EXTENSION_NAME });
+	VkPhysicalDeviceShaderObjectFeaturesEXT supported_shader_object_features = {};
+	supported_shader_object_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+	const bool shader_object_extension =
+	    physical_device_has_required_extensions(m_physical.m_handle, { VK_EXT_SHADER_OBJECT_EXTENSION_NAME });
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supported_pipeline_library_features = {};
+	supported_pipeline_library_features.sType =
+	    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	const bool pipeline_library_extension = physical_device_has_required_extensions(
+	    m_physical.m_handle,
+	    { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME });
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supported_dynamic_state3_features = {};
+	supported_dynamic_state3_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	const bool dynamic_state3_extension = physical_device_has_required_extensions(
+	    m_physical.m_handle, { VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME });
+	VkPhysicalDeviceVulkan12Features supported_vulkan12_features = {};
+	supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	supported_vulkan12_features.pNext = mesh_shader_extension ? &supported_mesh_shader_features : nullptr;
+	if (shader_object_extension)
+	{
+		supported_shader_object_features.pNext = supported_vulkan12_features.pNext;
+		supported_vulkan12_features.pNext = &supported_shader_object_features;
+	}
+	if (pipeline_library_extension)
+	{
+		supported_pipeline_library_features.pNext = supported_vulkan12_features.pNext;
+		supported_vulkan12_features.pNext = &supported_pipeline_library_features;
+	}
+	if (dynamic_state3_extension)
+	{
+		supported_dynamic_state3_features.pNext = supported_vulkan12_features.pNext;
+		supported_vulkan12_features.pNext = &supported_dynamic_state3_features;
+	}
+	VkPhysicalDeviceFeatures2 supported_features = {};
+	supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supported_features.pNext = &supported_vulkan12_features;
+	vkGetPhysicalDeviceFeatures2(m_physical.m_handle, &supported_features);
+
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12_features.drawIndirectCount = supported_vulkan12_features.drawIndirectCount;
+	m_features.m_draw_indirect_count = supported_vulkan12_features.drawIndirectCount;
+	if (!m_features.m_draw_indirect_count)
+	{
+		logger::warn("drawIndirectCount not supported, GPU-driven rendering unavailable");
+	}
+
+	/* Mesh shading path, static meshes fall back to vertex shading without it. */
+	VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features = {};
+	mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	mesh_shader_features.taskShader = supported_mesh_shader_features.taskShader;
+	mesh_shader_features.meshShader = supported_mesh_shader_features.meshShader;
+	m_features.m_mesh_shader = mesh_shader_features.taskShader && mesh_shader_features.meshShader;
+	if (m_features.m_mesh_shader)
+	{
+		add_extension(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		vulkan12_features.pNext = &mesh_shader_features;
+	}
+	else
+	{
+		logger::warn("Task and mesh shaders not supported, mesh shading unavailable");
+	}
+
+	/* Shader object path, graphics pipelines are bound as VkPipelines without it. */
+	VkPhysicalDeviceShaderObjectFeaturesEXT shader_object_features = {};
+	shader_object_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+	shader_object_features.shaderObject = supported_shader_object_features.shaderObject;
+	m_features.m_shader_object = shader_object_features.shaderObject;
+	if (m_features.m_shader_object)
+	{
+		add_extension(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+		shader_object_features.pNext = vulkan12_features.pNext;
+		vulkan12_features.pNext = &shader_object_features;
+	}
+	else
+	{
+		logger::warn("Shader objects not supported, shader object rendering unavailable");
+	}
+
+	/* Graphics pipelines are linked from separately cached parts, they are compiled whole without it. */
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipeline_library_features = {};
+	pipeline_library_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	pipeline_library_features.graphicsPipelineLibrary = supported_pipeline_library_features.graphicsPipelineLibrary;
+	m_features.m_graphics_pipeline_library = pipeline_library_features.graphicsPipelineLibrary;
+	if (m_features.m_graphics_pipeline_library)
+	{
+		add_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		add_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		pipeline_library_features.pNext = vulkan12_features.pNext;
+		vulkan12_features.pNext = &pipeline_library_features;
+	}
+	else
+	{
+		logger::warn("Graphics pipeline libraries not supported, pipelines are compiled whole");
+	}
+
+	/* Extended dynamic state 1 and 2 are core, 3 makes multisampling and blending dynamic too. */
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamic_state3_features = {};
+	dynamic_state3_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	dynamic_state3_features.extendedDynamicState3RasterizationSamples =
+	    supported_dynamic_state3_features.extendedDynamicState3RasterizationSamples;
+	dynamic_state3_features.extendedDynamicState3ColorBlendEnable =
+	    supported_dynamic_state3_features.extendedDynamicState3ColorBlendEnable;
+	dynamic_state3_features.extendedDynamicState3ColorBlendEquation =
+	    supported_dynamic_state3_features.extendedDynamicState3ColorBlendEquation;
+	dynamic_state3_features.extendedDynamicState3ColorWriteMask =
+	    supported_dynamic_state3_features.extendedDynamicState3ColorWriteMask;
+	m_features.m_dynamic_rasterization_samples = dynamic_state3_features.extendedDynamicState3RasterizationSamples;
+	m_features.m_dynamic_blend = dynamic_state3_features.extendedDynamicState3ColorBlendEnable &&
+	                             dynamic_state3_features.extendedDynamicState3ColorBlendEquation;
+	m_features.m_dynamic_color_write_mask = dynamic_state3_features.extendedDynamicState3ColorWriteMask;
+	if (dynamic_state3_extension)
+	{
+		add_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+		dynamic_state3_features.pNext = vulkan12_features.pNext;
+		vulkan12_features.pNext = &dynamic_state3_features;
+	}
+	else
+	{
+		logger::warn("Extended dynamic state 3 not supported, sample count and blend changes rebuild pipelines");
+	}
+
+	/* Depth resolve is core in Vulkan 1.2, only the resolve modes beyond SAMPLE_ZERO are optional. */
+	VkPhysicalDeviceDepthStencilResolveProperties depth_stencil_resolve_properties = {};
+	depth_stencil_resolve_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &depth_stencil_resolve_properties;
+	vkGetPhysicalDeviceProperties2(m_physical.m_handle, &properties);
+	m_features.m_depth_resolve_modes = depth_stencil_resolve_properties.supportedDepthResolveModes;
+
+	/* Required by bindless textures, runtime sized texture arrays that are updated after bind. */
+	VkPhysicalDeviceFeatures features = {};
+	features.shaderSampledImageArrayDynamicIndexing =
+	    supported_features.features.shaderSampledImageArrayDynamicIndexing;
+	vulkan12_features.runtimeDescriptorArray = supported_vulkan12_features.runtimeDescriptorArray;
+	vulkan12_features.descriptorBindingPartiallyBound = supported_vulkan12_features.descriptorBindingPartiallyBound;
+	vulkan12_features.descriptorBindingSampledImageUpdateAfterBind =
+	    supported_vulkan12_features.descriptorBindingSampledImageUpdateAfterBind;
+	vulkan12_features.shaderSampledImageArrayNonUniformIndexing =
+	    supported_vulkan12_features.shaderSampledImageArrayNonUniformIndexing;
+	assert_if(!features.shaderSampledImageArrayDynamicIndexing || !vulkan12_features.runtimeDescriptorArray ||
+	              !vulkan12_features.descriptorBindingPartiallyBound ||
+	              !vulkan12_features.descriptorBindingSampledImageUpdateAfterBind ||
+	              !vulkan12_features.shaderSampledImageArrayNonUniformIndexing,
+	          "Descriptor indexing not supported, required for bindless textures");
+
 	VkDeviceCreateInfo device_create_info = {};
 	device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	device_create_info.pNext = &vulkan12_features;
+	device_create_info.pEnabledFeatures = &features;
 	device_create_info.pQueueCreateInfos = &queue_create_info;
 	device_create_info.queueCreateInfoCount = 1;
 	add_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
@@ -14,6 +14,8 @@
 namespace vulkan
 {
 
+class pipeline_registry;
+
 class device
 {
 public:
@@ -40,6 +42,27 @@ public:
 		VkDevice m_handle = {};
 	} m_logical = {};
 
+	/* Device-wide pipeline cache and registry used by all pipeline creation, owned by the context. */
+	VkPipelineCache m_pipeline_cache = {};
+	pipeline_registry *m_pipeline_registry = nullptr;
+
+	/* Optional features, enabled if supported. */
+	struct
+	{
+		bool m_draw_indirect_count = false;
+		bool m_mesh_shader = false; /* VK_EXT_mesh_shader with task shaders. */
+		bool m_shader_object = false;
+		bool m_graphics_pipeline_library = false; /* VK_EXT_graphics_pipeline_library. */
+
+		/* VK_EXT_extended_dynamic_state3 state. */
+		bool m_dynamic_rasterization_samples = false;
+		bool m_dynamic_blend = false; /* Enable and equation. */
+		bool m_dynamic_color_write_mask = false;
+
+		/* Depth resolve modes, SAMPLE_ZERO is always supported. */
+		VkResolveModeFlags m_depth_resolve_modes = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+	} m_features = {};
+
 	void add_extension(const char *extension);
 	void log_info();
 	void build(instance &instance, VkSurfaceKHR surface, const VpProfileProperties &vp_profile_properties);
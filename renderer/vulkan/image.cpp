@@ -5,6 +5,7 @@
 #include "buffer.h"
 #include "command_buffer.h"
 #include "context.h"
+#include "descriptor_set.h"
 #include "image.h"
 #include "util.h"
 
@@ -251,7 +252,7 @@ image_view::~image_view()
 	}
 }
 
-void image_view::build(device &device, const image &image)
+void image_view::build(device &device, const image &image, u32 base_mip_level, u32 mip_level_count)
 {
 	m_image = &image;
 
@@ -268,8 +269,8 @@ void image_view::build(device &device, const image &image)
 	create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
 	create_info.subresourceRange.aspectMask = get_aspect_from_format(m_image->m_info.m_format);
-	create_info.subresourceRange.baseMipLevel = 0;
-	create_info.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	create_info.subresourceRange.baseMipLevel = base_mip_level;
+	create_info.subresourceRange.levelCount = mip_level_count;
 	create_info.subresourceRange.baseArrayLayer = 0;
 	create_info.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
@@ -280,6 +281,10 @@ void image_view::build(device &device, const image &image)
 
 texture::~texture()
 {
+	if (nullptr != m_bindless_table)
+	{
+		m_bindless_table->remove_texture(*this);
+	}
 	if (VK_NULL_HANDLE != m_sampler)
 	{
 		vkDestroySampler(m_device_handle, m_sampler, nullptr);
@@ -16,6 +16,7 @@
 namespace vulkan
 {
 
+class bindless_table;
 class context;
 
 struct image_info
@@ -70,7 +71,8 @@ public:
 	image_view(const image_view &) = delete;
 	image_view operator=(const image_view &) = delete;
 
-	void build(device &device, const image &image);
+	void build(device &device, const image &image, u32 base_mip_level = 0,
+	           u32 mip_level_count = VK_REMAINING_MIP_LEVELS);
 
 	VkImageView m_handle = {};
 	const image *m_image = nullptr;
@@ -96,7 +98,13 @@ public:
 	VkSampler m_sampler = VK_NULL_HANDLE;
 
 private:
+	friend class bindless_table;
+
 	VkDevice m_device_handle = {};
+
+	/* Set by bindless_table::add_texture, the index is released again on destruction. */
+	bindless_table *m_bindless_table = nullptr;
+	u32 m_bindless_index = 0;
 };
 
 } /* namespace vulkan */
@@ -1,13 +1,35 @@
 #include <algorithm>
+#include <bit>
+#include <iterator>
 
 #include <utils/util.h>
 
+#include "command_buffer.h"
 #include "pipeline.h"
 #include "util.h"
 
 namespace vulkan
 {
 
+/* Dynamic topology may only change within a class, see dynamicPrimitiveTopologyUnrestricted. */
+static u32 get_topology_class(VkPrimitiveTopology topology)
+{
+	switch (topology)
+	{
+	case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+		return 0;
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+		return 1;
+	case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
 pipeline_layout::~pipeline_layout()
 {
 	if (m_handle != VK_NULL_HANDLE)
@@ -21,38 +43,76 @@ void pipeline_layout::add_shader(const shader_module &shader)
 	/* Resource layout. */
 	for (const shader_resource_binding &shader_binding : shader.m_resource_bindings)
 	{
-		if (std::any_of(m_resource_bindings.begin(), m_resource_bindings.end(),
-		                [shader_binding](const shader_resource_binding &b)
-		                { return b.binding == shader_binding.binding; }))
+		const auto it = std::find_if(m_resource_bindings.begin(), m_resource_bindings.end(),
+		                             [&](const layout_binding &b)
+		                             { return b.set == shader_binding.set && b.binding == shader_binding.binding; });
+		if (it != m_resource_bindings.end())
 		{
-			/* Don't allow duplicate bindings. */
+			assert_if(it->type != shader_binding.type, "Set %u binding %u is declared with different types",
+			          shader_binding.set, shader_binding.binding);
+			it->stages |= shader.m_stage;
 			continue;
 		}
-		m_resource_bindings.push_back(shader_binding);
+		m_resource_bindings.push_back({ .set = shader_binding.set,
+		                                .binding = shader_binding.binding,
+		                                .type = shader_binding.type,
+		                                .stages = (VkShaderStageFlags)shader.m_stage });
 	}
 
-	/* Push constants. */
+	/* Push constants, one range visible to the stages that declare them. */
 	m_push_constants_size = std::max(m_push_constants_size, shader.m_push_constants_size);
+	if (shader.m_push_constants_size > 0)
+	{
+		m_push_constants_stages |= shader.m_stage;
+	}
+	m_stages |= shader.m_stage;
 }
 
 void pipeline_layout::build(device &device)
 {
-	for (const shader_resource_binding &binding : m_resource_bindings)
+	/* Sets are defined up to the highest one used, unused sets below it are empty. The bindless set is always defined
+	 * with its fixed layout, and pass and material sets are visible to all stages, so that every pipeline using them
+	 * defines them identically and they stay bound across pipelines with the same push constant range. Only the draw
+	 * set is pushed, with the stages that declare each binding. Sorted bindings define a set identically however the
+	 * stages order their declarations. */
+	std::sort(m_resource_bindings.begin(), m_resource_bindings.end(),
+	          [](const layout_binding &a, const layout_binding &b)
+	          { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+	u32 set_count = 1;
+	for (const layout_binding &binding : m_resource_bindings)
 	{
-		assert_if(binding.set != 0, "Only descriptor set index 0 is supported");
-		m_dset_layout.add_binding(binding.binding, binding.type);
+		set_count = std::max(set_count, binding.set + 1);
+		if (bindless_table::set_index != binding.set)
+		{
+			const VkShaderStageFlags stages = descriptor_set_draw == binding.set ? binding.stages : VK_SHADER_STAGE_ALL;
+			m_dset_layouts[binding.set].add_binding(binding.binding, binding.type, 1, 0, stages);
+		}
+	}
+	m_set_layouts.clear();
+	for (u32 set = 0; set < set_count; ++set)
+	{
+		if (bindless_table::set_index == set)
+		{
+			bindless_table::build_layout(device, m_dset_layouts[set]);
+		}
+		else
+		{
+			const VkDescriptorSetLayoutCreateFlags flags =
+			    descriptor_set_draw == set ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
+			m_dset_layouts[set].build(device, flags);
+		}
+		m_set_layouts.push_back(m_dset_layouts[set].m_handle);
 	}
-	m_dset_layout.build(device);
 
 	VkPushConstantRange push_constants = {};
-	push_constants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constants.stageFlags = m_push_constants_stages;
 	push_constants.offset = 0;
 	push_constants.size = m_push_constants_size;
 
 	VkPipelineLayoutCreateInfo pipeline_layout_info = {};
 	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_info.setLayoutCount = 1;
-	pipeline_layout_info.pSetLayouts = &m_dset_layout.m_handle;
+	pipeline_layout_info.setLayoutCount = m_set_layouts.size();
+	pipeline_layout_info.pSetLayouts = m_set_layouts.data();
 	if (m_push_constants_size > 0)
 	{
 		pipeline_layout_info.pushConstantRangeCount = 1;
@@ -65,6 +125,13 @@ void pipeline_layout::build(device &device)
 	}
 	VULKAN_ASSERT_SUCCESS(vkCreatePipelineLayout(device.m_logical.m_handle, &pipeline_layout_info, nullptr, &m_handle));
 
+	u64 hash = hash_combine(m_push_constants_size > 0 ? m_push_constants_stages : 0, m_push_constants_size);
+	for (u32 set = 0; set < set_count; ++set)
+	{
+		hash = hash_combine(hash, m_dset_layouts[set].m_hash);
+		m_set_compatibility[set] = hash;
+	}
+
 	m_device_handle = device.m_logical.m_handle;
 }
 
@@ -85,9 +152,9 @@ pipeline::pipeline()
 
 	m_viewport_info = {};
 	m_viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	m_viewport_info.viewportCount = 1;
+	m_viewport_info.viewportCount = 0;
 	m_viewport_info.pViewports = nullptr;
-	m_viewport_info.scissorCount = 1;
+	m_viewport_info.scissorCount = 0;
 	m_viewport_info.pScissors = nullptr;
 
 	m_rasterizer_info = {};
@@ -148,8 +215,9 @@ pipeline::pipeline()
 	m_blending_info.blendConstants[2] = 0.0f;
 	m_blending_info.blendConstants[3] = 0.0f;
 
-	m_dynamic_states.push_back(VK_DYNAMIC_STATE_VIEWPORT);
-	m_dynamic_states.push_back(VK_DYNAMIC_STATE_SCISSOR);
+	/* Counts are dynamic too, shader objects require them to be. */
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT);
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT);
 	m_dynamic_state_info = {};
 	m_dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 	m_dynamic_state_info.pNext = nullptr;
@@ -160,17 +228,18 @@ pipeline::pipeline()
 
 pipeline::~pipeline()
 {
-	if (m_handle != VK_NULL_HANDLE)
+	/* In flight compiles may still use the pipeline layout. */
+	if (nullptr != m_device)
 	{
-		vkDestroyPipeline(m_device_handle, m_handle, nullptr);
+		m_device->m_pipeline_registry->remove_pending(*this);
+		m_device->m_pipeline_registry->wait_idle();
 	}
 }
 
 void pipeline::add_shader(device &device, VkShaderStageFlagBits stage, const char *path)
 {
 	assert_if(m_shader_modules.contains(stage), "Pipeline already contains stage %u", stage);
-	ref<shader_module> sm = make_ref<shader_module>();
-	sm->build(device, stage, path);
+	ref<shader_module> sm = device.m_pipeline_registry->get_shader_module(device, stage, path);
 	m_shader_modules[stage] = sm;
 	m_pipeline_layout.add_shader(*sm);
 	m_stage_create_infos.push_back(sm->get_pipeline_shader_stage_create_info());
@@ -185,6 +254,21 @@ void pipeline::add_shader(const ref<shader_module> &shader)
 	m_stage_create_infos.push_back(shader->get_pipeline_shader_stage_create_info());
 }
 
+void pipeline::set_vertex_attribute_format(u32 location, VkFormat format)
+{
+	m_vertex_attribute_formats[location] = format;
+}
+
+void pipeline::set_vertex_attribute_binding(u32 location, u32 binding)
+{
+	m_vertex_attribute_bindings[location] = binding;
+}
+
+void pipeline::set_vertex_binding_input_rate(u32 binding, VkVertexInputRate input_rate)
+{
+	m_vertex_binding_input_rates[binding] = input_rate;
+}
+
 void pipeline::set_sample_count(VkSampleCountFlagBits sample_count)
 {
 	m_multisampling_info.rasterizationSamples = sample_count;
@@ -228,6 +312,21 @@ void pipeline::set_blend_enable(VkBool32 blend_enable)
 	}
 }
 
+void pipeline::set_color_write_mask(VkColorComponentFlags color_write_mask)
+{
+	m_blend_attachment_state.colorWriteMask = color_write_mask;
+}
+
+void pipeline::set_depth_write_enable(VkBool32 depth_write_enable)
+{
+	m_depth_stencil_info.depthWriteEnable = depth_write_enable;
+}
+
+void pipeline::set_depth_compare_op(VkCompareOp depth_compare_op)
+{
+	m_depth_stencil_info.depthCompareOp = depth_compare_op;
+}
+
 void pipeline::set_color_format(VkFormat format)
 {
 	m_color_format = format;
@@ -239,58 +338,652 @@ void pipeline::set_depth_format(VkFormat format)
 	m_rendering_info.depthAttachmentFormat = format;
 }
 
+void pipeline::set_specialization_constant(u32 constant_id, u32 value)
+{
+	assert_if(std::none_of(m_shader_modules.begin(), m_shader_modules.end(),
+	                       [&](const auto &shader)
+	                       {
+		                       const std::vector<u32> &ids = shader.second->m_specialization_constant_ids;
+		                       return std::find(ids.begin(), ids.end(), constant_id) != ids.end();
+	                       }),
+	          "No shader of the pipeline declares specialization constant %u", constant_id);
+	m_specialization_changed = m_specialization_changed || !m_specialization_constants.contains(constant_id) ||
+	                           m_specialization_constants[constant_id] != value;
+	m_specialization_constants[constant_id] = value;
+}
+
+ref<graphics_pipeline_desc> pipeline::get_desc() const
+{
+	ref<graphics_pipeline_desc> desc = make_ref<graphics_pipeline_desc>();
+	for (const VkPipelineShaderStageCreateInfo &stage : m_stage_create_infos)
+	{
+		desc->m_shader_modules.push_back(m_shader_modules.at(stage.stage));
+	}
+	desc->m_mesh = m_shader_modules.contains(VK_SHADER_STAGE_MESH_BIT_EXT);
+	desc->m_vbds = m_vbds;
+	desc->m_vads = m_vads;
+	desc->m_dynamic_states = m_dynamic_states;
+	for (const auto &[constant_id, value] : m_specialization_constants)
+	{
+		desc->m_specialization_entries.push_back({ .constantID = constant_id,
+		                                           .offset = (u32)(desc->m_specialization_data.size() * sizeof(u32)),
+		                                           .size = sizeof(u32) });
+		desc->m_specialization_data.push_back(value);
+	}
+	desc->m_input_assembly = m_input_assembly;
+	desc->m_viewport_info = m_viewport_info;
+	desc->m_rasterizer_info = m_rasterizer_info;
+	desc->m_multisampling_info = m_multisampling_info;
+	desc->m_depth_stencil_info = m_depth_stencil_info;
+	desc->m_blend_attachment_state = m_blend_attachment_state;
+	desc->m_blending_info = m_blending_info;
+	desc->m_dynamic_state_info = m_dynamic_state_info;
+	desc->m_color_format = m_color_format;
+	desc->m_rendering_info = m_rendering_info;
+	desc->m_layout = m_pipeline_layout.m_handle;
+	desc->link();
+	return desc;
+}
+
 void pipeline::finalize()
 {
 	/* Build the final pipeline. */
-	VkGraphicsPipelineCreateInfo pipeline_info = {};
-	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeline_info.pNext = &m_rendering_info;
-	pipeline_info.stageCount = m_stage_create_infos.size();
-	pipeline_info.pStages = m_stage_create_infos.data();
-	pipeline_info.pVertexInputState = &m_vertex_input_info;
-	pipeline_info.pInputAssemblyState = &m_input_assembly;
-	pipeline_info.pViewportState = &m_viewport_info;
-	pipeline_info.pRasterizationState = &m_rasterizer_info;
-	pipeline_info.pMultisampleState = &m_multisampling_info;
-	pipeline_info.pDepthStencilState = &m_depth_stencil_info;
-	pipeline_info.pColorBlendState = &m_blending_info;
-	pipeline_info.pDynamicState = &m_dynamic_state_info;
-	pipeline_info.layout = m_pipeline_layout.m_handle;
-	pipeline_info.renderPass = VK_NULL_HANDLE;
-	pipeline_info.subpass = 0;
-	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-	pipeline_info.basePipelineIndex = -1;
-	vkCreateGraphicsPipelines(m_device_handle, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_handle);
+	ref<graphics_pipeline_desc> desc = get_desc();
+	m_desc = desc;
+	if (uses_libraries())
+	{
+		m_shared = m_device->m_pipeline_registry->link_graphics_pipeline(*m_device, get_state_key(),
+		                                                                 get_library_keys(), desc);
+		m_device->m_pipeline_registry->add_unoptimized(*this);
+	}
+	else
+	{
+		m_shared = m_device->m_pipeline_registry->get_graphics_pipeline(*m_device, get_state_key(), *desc);
+	}
+	m_handle = m_shared->m_handle;
 }
 
-void pipeline::build(device &device)
+bool pipeline::uses_libraries() const
 {
-	assert_if(!m_shader_modules.contains(VK_SHADER_STAGE_VERTEX_BIT),
-	          "Cannot build a pipeline without a vertex shader");
+	/* Mesh pipelines have no vertex input part, they are always compiled whole. */
+	return m_device->m_features.m_graphics_pipeline_library &&
+	       !m_shader_modules.contains(VK_SHADER_STAGE_MESH_BIT_EXT);
+}
 
-	m_device_handle = device.m_logical.m_handle;
+void pipeline::swap_pending()
+{
+	/* The previous VkPipeline is released once no other pipeline shares it. */
+	m_shared = std::move(m_pending);
+	m_desc = std::move(m_pending_desc);
+	m_handle = m_shared->m_handle;
+}
+
+void pipeline::add_shader_state(pipeline_key &key) const
+{
+	/* Shader stages in a fixed order, the module map is unordered. Specialization constants select a variant. */
+	std::vector<std::pair<VkShaderStageFlagBits, ref<shader_module>>> shaders = {};
+	for (const auto &[stage, shader] : m_shader_modules)
+	{
+		shaders.push_back({ stage, shader });
+	}
+	std::sort(shaders.begin(), shaders.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+	for (const auto &[stage, shader] : shaders)
+	{
+		key.add(stage);
+		key.add(shader);
+	}
+	for (const auto &[constant_id, value] : m_specialization_constants)
+	{
+		key.add(constant_id);
+		key.add(value);
+	}
+}
+
+void pipeline::add_dynamic_state(pipeline_key &key) const
+{
+	key.add(m_dynamic_states.size());
+	for (VkDynamicState dynamic_state : m_dynamic_states)
+	{
+		key.add(dynamic_state);
+	}
+}
+
+graphics_pipeline_library_keys pipeline::get_library_keys() const
+{
+	graphics_pipeline_library_keys keys = {};
+
+	/* Dynamic state is left out, it is set when the pipeline is bound. */
+	const auto baked = [&](VkDynamicState dynamic_state, u64 value) { return is_dynamic(dynamic_state) ? 0 : value; };
+
+	/* Vertex input, only used without a mesh shader. Variable length state is preceded by its count. */
+	pipeline_key &vertex_input = keys.vertex_input;
+	add_dynamic_state(vertex_input);
+	vertex_input.add(m_vbds.size());
+	for (const VkVertexInputBindingDescription &vbd : m_vbds)
+	{
+		vertex_input.add(vbd.binding);
+		vertex_input.add(vbd.stride);
+		vertex_input.add(vbd.inputRate);
+	}
+	vertex_input.add(m_vads.size());
+	for (const VkVertexInputAttributeDescription &vad : m_vads)
+	{
+		vertex_input.add(vad.location);
+		vertex_input.add(vad.binding);
+		vertex_input.add(vad.format);
+		vertex_input.add(vad.offset);
+	}
+	vertex_input.add(is_dynamic(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY) ? get_topology_class(m_input_assembly.topology)
+	                                                                 : m_input_assembly.topology);
+	vertex_input.add(m_input_assembly.primitiveRestartEnable);
+
+	/* Rasterization. Both shader parts key all stages, they must be linked with the same pipeline layout. */
+	pipeline_key &pre_rasterization = keys.pre_rasterization;
+	add_shader_state(pre_rasterization);
+	add_dynamic_state(pre_rasterization);
+	pre_rasterization.add(m_rasterizer_info.depthClampEnable);
+	pre_rasterization.add(m_rasterizer_info.rasterizerDiscardEnable);
+	pre_rasterization.add(m_rasterizer_info.polygonMode);
+	pre_rasterization.add(baked(VK_DYNAMIC_STATE_CULL_MODE, m_rasterizer_info.cullMode));
+	pre_rasterization.add(baked(VK_DYNAMIC_STATE_FRONT_FACE, m_rasterizer_info.frontFace));
+	pre_rasterization.add(m_rasterizer_info.depthBiasEnable);
+	pre_rasterization.add(std::bit_cast<u32>(m_rasterizer_info.depthBiasConstantFactor));
+	pre_rasterization.add(std::bit_cast<u32>(m_rasterizer_info.depthBiasClamp));
+	pre_rasterization.add(std::bit_cast<u32>(m_rasterizer_info.depthBiasSlopeFactor));
+	pre_rasterization.add(std::bit_cast<u32>(m_rasterizer_info.lineWidth));
+
+	/* Depth, stencil is never enabled. */
+	pipeline_key &fragment_shader = keys.fragment_shader;
+	add_shader_state(fragment_shader);
+	add_dynamic_state(fragment_shader);
+	fragment_shader.add(baked(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE, m_depth_stencil_info.depthTestEnable));
+	fragment_shader.add(baked(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE, m_depth_stencil_info.depthWriteEnable));
+	fragment_shader.add(baked(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP, m_depth_stencil_info.depthCompareOp));
+	fragment_shader.add(m_depth_stencil_info.depthBoundsTestEnable);
+	fragment_shader.add(m_depth_stencil_info.stencilTestEnable);
+	fragment_shader.add(m_rendering_info.depthAttachmentFormat);
+	fragment_shader.add(m_rendering_info.stencilAttachmentFormat);
+
+	/* Multisampling, blending and attachment formats. */
+	pipeline_key &fragment_output = keys.fragment_output;
+	add_dynamic_state(fragment_output);
+	fragment_output.add(baked(VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT, m_multisampling_info.rasterizationSamples));
+	fragment_output.add(m_multisampling_info.sampleShadingEnable);
+	fragment_output.add(std::bit_cast<u32>(m_multisampling_info.minSampleShading));
+	fragment_output.add(m_multisampling_info.alphaToCoverageEnable);
+	fragment_output.add(m_multisampling_info.alphaToOneEnable);
+	if (!is_dynamic(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT))
+	{
+		fragment_output.add(m_blend_attachment_state.blendEnable);
+		fragment_output.add(m_blend_attachment_state.srcColorBlendFactor);
+		fragment_output.add(m_blend_attachment_state.dstColorBlendFactor);
+		fragment_output.add(m_blend_attachment_state.colorBlendOp);
+		fragment_output.add(m_blend_attachment_state.srcAlphaBlendFactor);
+		fragment_output.add(m_blend_attachment_state.dstAlphaBlendFactor);
+		fragment_output.add(m_blend_attachment_state.alphaBlendOp);
+	}
+	fragment_output.add(baked(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT, m_blend_attachment_state.colorWriteMask));
+	fragment_output.add(m_blending_info.logicOpEnable);
+	fragment_output.add(m_blending_info.logicOp);
+	fragment_output.add(m_color_format);
+	fragment_output.add(m_rendering_info.depthAttachmentFormat);
+	fragment_output.add(m_rendering_info.stencilAttachmentFormat);
+
+	return keys;
+}
+
+pipeline_key pipeline::get_state_key() const
+{
+	const graphics_pipeline_library_keys keys = get_library_keys();
+	pipeline_key key = {};
+	add_shader_state(key);
+	key.add(keys.vertex_input);
+	key.add(keys.pre_rasterization);
+	key.add(keys.fragment_shader);
+	key.add(keys.fragment_output);
+	return key;
+}
+
+void pipeline::build_vertex_input()
+{
+	const shader_module &vertex_shader = *m_shader_modules[VK_SHADER_STAGE_VERTEX_BIT];
+
+	/* Apply format and binding overrides, attributes are tightly packed per binding in location order. */
+	m_vads = vertex_shader.m_vads;
+	m_vbds.clear();
+	for (VkVertexInputAttributeDescription &vad : m_vads)
+	{
+		if (m_vertex_attribute_formats.contains(vad.location))
+		{
+			const VkFormat format = m_vertex_attribute_formats[vad.location];
+			assert_if(!is_vertex_format_compatible(vad.format, format),
+			          "Vertex attribute format %u incompatible with shader input at location %u", format, vad.location);
+			vad.format = format;
+		}
+		if (m_vertex_attribute_bindings.contains(vad.location))
+		{
+			vad.binding = m_vertex_attribute_bindings[vad.location];
+		}
+
+		auto vbd = std::find_if(m_vbds.begin(), m_vbds.end(),
+		                        [&](const VkVertexInputBindingDescription &b) { return b.binding == vad.binding; });
+		if (vbd == m_vbds.end())
+		{
+			const VkVertexInputRate input_rate = m_vertex_binding_input_rates.contains(vad.binding)
+			                                         ? m_vertex_binding_input_rates[vad.binding]
+			                                         : VK_VERTEX_INPUT_RATE_VERTEX;
+			m_vbds.push_back({ .binding = vad.binding, .stride = 0, .inputRate = input_rate });
+			vbd = m_vbds.end() - 1;
+		}
+		vad.offset = vbd->stride;
+		vbd->stride += get_vertex_format_size(vad.format);
+	}
 
 	m_vertex_input_info = {};
 	m_vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	if (m_shader_modules[VK_SHADER_STAGE_VERTEX_BIT]->m_vads.size() != 0)
+	if (m_vads.size() != 0)
+	{
+		m_vertex_input_info.vertexBindingDescriptionCount = m_vbds.size();
+		m_vertex_input_info.pVertexBindingDescriptions = m_vbds.data();
+		m_vertex_input_info.vertexAttributeDescriptionCount = m_vads.size();
+		m_vertex_input_info.pVertexAttributeDescriptions = m_vads.data();
+	}
+}
+
+void pipeline::build_shader_objects()
+{
+	const VkPushConstantRange push_constants = {
+		.stageFlags = m_pipeline_layout.m_push_constants_stages, //
+		.offset = 0,                                             //
+		.size = m_pipeline_layout.m_push_constants_size,         //
+	};
+	const ref<graphics_pipeline_desc> desc = get_desc();
+	const VkSpecializationInfo *specialization_info =
+	    desc->m_specialization_entries.empty() ? nullptr : &desc->m_specialization_info;
+	m_shader_objects.clear();
+	for (const auto &[stage, shader] : m_shader_modules)
 	{
-		m_vertex_input_info.vertexBindingDescriptionCount = 1;
-		m_vertex_input_info.pVertexBindingDescriptions = &m_shader_modules[VK_SHADER_STAGE_VERTEX_BIT]->m_vbd;
-		m_vertex_input_info.vertexAttributeDescriptionCount =
-		    m_shader_modules[VK_SHADER_STAGE_VERTEX_BIT]->m_vads.size();
-		m_vertex_input_info.pVertexAttributeDescriptions = m_shader_modules[VK_SHADER_STAGE_VERTEX_BIT]->m_vads.data();
+		m_shader_objects.push_back(make_uref<shader_object>());
+		m_shader_objects.back()->build(*m_device, *shader, m_pipeline_layout.m_set_layouts,
+		                               push_constants.size > 0 ? &push_constants : nullptr, specialization_info);
 	}
 
+	m_vertex_binding_descriptions.clear();
+	m_vertex_attribute_descriptions.clear();
+
+	for (const VkVertexInputBindingDescription &vbd : m_vbds)
+	{
+		m_vertex_binding_descriptions.push_back({
+		    .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT, //
+		    .pNext = nullptr,                                                   //
+		    .binding = vbd.binding,                                             //
+		    .stride = vbd.stride,                                               //
+		    .inputRate = vbd.inputRate,                                         //
+		    .divisor = 1,                                                       //
+		});
+	}
+	for (const VkVertexInputAttributeDescription &vad : m_vads)
+	{
+		m_vertex_attribute_descriptions.push_back({
+		    .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, //
+		    .pNext = nullptr,                                                     //
+		    .location = vad.location,                                             //
+		    .binding = vad.binding,                                               //
+		    .format = vad.format,                                                 //
+		    .offset = vad.offset,                                                 //
+		});
+	}
+}
+
+template <typename T>
+u64 pipeline::get_state(VkDynamicState dynamic_state, const T &state)
+{
+	switch (dynamic_state)
+	{
+	case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY:
+		return state.m_input_assembly.topology;
+	case VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE:
+		return state.m_input_assembly.primitiveRestartEnable;
+	case VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE:
+		return state.m_rasterizer_info.rasterizerDiscardEnable;
+	case VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT:
+		return state.m_rasterizer_info.depthClampEnable;
+	case VK_DYNAMIC_STATE_POLYGON_MODE_EXT:
+		return state.m_rasterizer_info.polygonMode;
+	case VK_DYNAMIC_STATE_CULL_MODE:
+		return state.m_rasterizer_info.cullMode;
+	case VK_DYNAMIC_STATE_FRONT_FACE:
+		return state.m_rasterizer_info.frontFace;
+	case VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE:
+		return state.m_rasterizer_info.depthBiasEnable;
+	case VK_DYNAMIC_STATE_LINE_WIDTH:
+		return std::bit_cast<u32>(state.m_rasterizer_info.lineWidth);
+	case VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT:
+	case VK_DYNAMIC_STATE_SAMPLE_MASK_EXT:
+		return state.m_multisampling_info.rasterizationSamples;
+	case VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT:
+		return state.m_multisampling_info.alphaToCoverageEnable;
+	case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE:
+		return state.m_depth_stencil_info.depthTestEnable;
+	case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE:
+		return state.m_depth_stencil_info.depthWriteEnable;
+	case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP:
+		return state.m_depth_stencil_info.depthCompareOp;
+	case VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE:
+		return state.m_depth_stencil_info.depthBoundsTestEnable;
+	case VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE:
+		return state.m_depth_stencil_info.stencilTestEnable;
+	case VK_DYNAMIC_STATE_LOGIC_OP_ENABLE_EXT:
+		return state.m_blending_info.logicOpEnable;
+	case VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT:
+		return state.m_blend_attachment_state.blendEnable;
+	case VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT:
+	{
+		/* Factors and core blend ops fit in a byte each, advanced blend ops can not be set by this state. */
+		const VkPipelineColorBlendAttachmentState &blend = state.m_blend_attachment_state;
+		return (u64)blend.srcColorBlendFactor | (u64)blend.dstColorBlendFactor << 8 | (u64)blend.colorBlendOp << 16 |
+		       (u64)blend.srcAlphaBlendFactor << 24 | (u64)blend.dstAlphaBlendFactor << 32 |
+		       (u64)blend.alphaBlendOp << 40;
+	}
+	case VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT:
+		return state.m_blend_attachment_state.colorWriteMask;
+	default:
+		assert_if(true, "Unsupported dynamic state %u", dynamic_state);
+		return 0;
+	}
+}
+
+template <typename T>
+void pipeline::set_state(VkCommandBuffer command_buffer, VkDynamicState dynamic_state, const T &state)
+{
+	switch (dynamic_state)
+	{
+	case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY:
+		vkCmdSetPrimitiveTopology(command_buffer, state.m_input_assembly.topology);
+		break;
+	case VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE:
+		vkCmdSetPrimitiveRestartEnable(command_buffer, state.m_input_assembly.primitiveRestartEnable);
+		break;
+	case VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE:
+		vkCmdSetRasterizerDiscardEnable(command_buffer, state.m_rasterizer_info.rasterizerDiscardEnable);
+		break;
+	case VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT:
+		vkCmdSetDepthClampEnableEXT(command_buffer, state.m_rasterizer_info.depthClampEnable);
+		break;
+	case VK_DYNAMIC_STATE_POLYGON_MODE_EXT:
+		vkCmdSetPolygonModeEXT(command_buffer, state.m_rasterizer_info.polygonMode);
+		break;
+	case VK_DYNAMIC_STATE_CULL_MODE:
+		vkCmdSetCullMode(command_buffer, state.m_rasterizer_info.cullMode);
+		break;
+	case VK_DYNAMIC_STATE_FRONT_FACE:
+		vkCmdSetFrontFace(command_buffer, state.m_rasterizer_info.frontFace);
+		break;
+	case VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE:
+		vkCmdSetDepthBiasEnable(command_buffer, state.m_rasterizer_info.depthBiasEnable);
+		break;
+	case VK_DYNAMIC_STATE_LINE_WIDTH:
+		vkCmdSetLineWidth(command_buffer, state.m_rasterizer_info.lineWidth);
+		break;
+	case VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT:
+		vkCmdSetRasterizationSamplesEXT(command_buffer, state.m_multisampling_info.rasterizationSamples);
+		break;
+	case VK_DYNAMIC_STATE_SAMPLE_MASK_EXT:
+	{
+		const VkSampleMask sample_mask = ~0u;
+		vkCmdSetSampleMaskEXT(command_buffer, state.m_multisampling_info.rasterizationSamples, &sample_mask);
+		break;
+	}
+	case VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT:
+		vkCmdSetAlphaToCoverageEnableEXT(command_buffer, state.m_multisampling_info.alphaToCoverageEnable);
+		break;
+	case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE:
+		vkCmdSetDepthTestEnable(command_buffer, state.m_depth_stencil_info.depthTestEnable);
+		break;
+	case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE:
+		vkCmdSetDepthWriteEnable(command_buffer, state.m_depth_stencil_info.depthWriteEnable);
+		break;
+	case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP:
+		vkCmdSetDepthCompareOp(command_buffer, state.m_depth_stencil_info.depthCompareOp);
+		break;
+	case VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE:
+		vkCmdSetDepthBoundsTestEnable(command_buffer, state.m_depth_stencil_info.depthBoundsTestEnable);
+		break;
+	case VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE:
+		vkCmdSetStencilTestEnable(command_buffer, state.m_depth_stencil_info.stencilTestEnable);
+		break;
+	case VK_DYNAMIC_STATE_LOGIC_OP_ENABLE_EXT:
+		vkCmdSetLogicOpEnableEXT(command_buffer, state.m_blending_info.logicOpEnable);
+		break;
+	case VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT:
+		vkCmdSetColorBlendEnableEXT(command_buffer, 0, 1, &state.m_blend_attachment_state.blendEnable);
+		break;
+	case VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT:
+	{
+		const VkColorBlendEquationEXT blend_equation = {
+			.srcColorBlendFactor = state.m_blend_attachment_state.srcColorBlendFactor, //
+			.dstColorBlendFactor = state.m_blend_attachment_state.dstColorBlendFactor, //
+			.colorBlendOp = state.m_blend_attachment_state.colorBlendOp,               //
+			.srcAlphaBlendFactor = state.m_blend_attachment_state.srcAlphaBlendFactor, //
+			.dstAlphaBlendFactor = state.m_blend_attachment_state.dstAlphaBlendFactor, //
+			.alphaBlendOp = state.m_blend_attachment_state.alphaBlendOp,               //
+		};
+		vkCmdSetColorBlendEquationEXT(command_buffer, 0, 1, &blend_equation);
+		break;
+	}
+	case VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT:
+		vkCmdSetColorWriteMaskEXT(command_buffer, 0, 1, &state.m_blend_attachment_state.colorWriteMask);
+		break;
+	default:
+		assert_if(true, "Unsupported dynamic state %u", dynamic_state);
+	}
+}
+
+bool pipeline::has_shader_objects() const
+{
+	return !m_shader_objects.empty();
+}
+
+void pipeline::bind_shader_objects(command_buffer &command_buffer) const
+{
+	/* Every stage the device enables is bound, stages without a shader object are unbound. Tessellation and geometry
+	 * shaders are never enabled, so they can not be bound. */
+	VkShaderStageFlagBits stages[4] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+	u32 stage_count = 2;
+	if (m_device->m_features.m_mesh_shader)
+	{
+		stages[stage_count++] = VK_SHADER_STAGE_TASK_BIT_EXT;
+		stages[stage_count++] = VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
+	VkShaderEXT shaders[std::size(stages)] = {};
+	for (const uref<shader_object> &shader : m_shader_objects)
+	{
+		const VkShaderStageFlagBits *stage = std::find(stages, stages + stage_count, shader->m_stage);
+		assert_if(stage == stages + stage_count, "Shader stage %u is not enabled", shader->m_stage);
+		shaders[stage - stages] = shader->m_handle;
+	}
+	vkCmdBindShadersEXT(command_buffer.m_handle, stage_count, stages, shaders);
+
+	vkCmdSetVertexInputEXT(command_buffer.m_handle, m_vertex_binding_descriptions.size(),
+	                       m_vertex_binding_descriptions.data(), m_vertex_attribute_descriptions.size(),
+	                       m_vertex_attribute_descriptions.data());
+
+	/* All state a VkPipeline would have baked in, except viewport and scissor. */
+	static constexpr VkDynamicState states[] = {
+		VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,        VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE,
+		VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE, VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT,
+		VK_DYNAMIC_STATE_POLYGON_MODE_EXT,          VK_DYNAMIC_STATE_CULL_MODE,
+		VK_DYNAMIC_STATE_FRONT_FACE,                VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE,
+		VK_DYNAMIC_STATE_LINE_WIDTH,                VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT,
+		VK_DYNAMIC_STATE_SAMPLE_MASK_EXT,           VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT,
+		VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,         VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+		VK_DYNAMIC_STATE_DEPTH_COMPARE_OP,          VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE,
+		VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE,       VK_DYNAMIC_STATE_LOGIC_OP_ENABLE_EXT,
+		VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT,    VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT,
+		VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT,
+	};
+	for (VkDynamicState dynamic_state : states)
+	{
+		if (command_buffer.update_dynamic_state(dynamic_state, get_state(dynamic_state, *this)))
+		{
+			set_state(command_buffer.m_handle, dynamic_state, *this);
+		}
+	}
+}
+
+void pipeline::set_dynamic_state(command_buffer &command_buffer) const
+{
+	/* Viewport and scissor are set by the command buffer. */
+	for (VkDynamicState dynamic_state : m_desc->m_dynamic_states)
+	{
+		if (VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT != dynamic_state &&
+		    VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT != dynamic_state &&
+		    command_buffer.update_dynamic_state(dynamic_state, get_state(dynamic_state, *m_desc)))
+		{
+			set_state(command_buffer.m_handle, dynamic_state, *m_desc);
+		}
+	}
+}
+
+bool pipeline::has_dynamic_state(VkDynamicState dynamic_state) const
+{
+	const std::vector<VkDynamicState> &dynamic_states = m_desc->m_dynamic_states;
+	return std::find(dynamic_states.begin(), dynamic_states.end(), dynamic_state) != dynamic_states.end();
+}
+
+bool pipeline::is_dynamic(VkDynamicState dynamic_state) const
+{
+	return std::find(m_dynamic_states.begin(), m_dynamic_states.end(), dynamic_state) != m_dynamic_states.end();
+}
+
+void pipeline::build(device &device)
+{
+	const bool mesh = m_shader_modules.contains(VK_SHADER_STAGE_MESH_BIT_EXT);
+	assert_if(!m_shader_modules.contains(VK_SHADER_STAGE_VERTEX_BIT) && !mesh,
+	          "Cannot build a pipeline without a vertex or mesh shader");
+	assert_if(m_shader_modules.contains(VK_SHADER_STAGE_VERTEX_BIT) && mesh,
+	          "Cannot build a pipeline with both vertex and mesh shaders");
+
+	m_device = &device;
+
+	if (!mesh)
+	{
+		build_vertex_input();
+	}
+
+	/* Core since 1.3. Formats stay baked in, dynamic rendering has no dynamic state for them. */
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_CULL_MODE);
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_FRONT_FACE);
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE);
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE);
+	m_dynamic_states.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP);
+	if (!mesh)
+	{
+		m_dynamic_states.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY);
+	}
+	if (device.m_features.m_dynamic_rasterization_samples)
+	{
+		m_dynamic_states.push_back(VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT);
+	}
+	if (device.m_features.m_dynamic_blend)
+	{
+		m_dynamic_states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+		m_dynamic_states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT);
+	}
+	if (device.m_features.m_dynamic_color_write_mask)
+	{
+		m_dynamic_states.push_back(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+	}
+	m_dynamic_state_info.dynamicStateCount = m_dynamic_states.size();
+	m_dynamic_state_info.pDynamicStates = m_dynamic_states.data();
+
 	m_pipeline_layout.build(device);
 	finalize();
+	m_specialization_changed = false;
+
+	/* Mesh pipelines are always bound as VkPipelines. */
+	if (device.m_features.m_shader_object && !mesh)
+	{
+		build_shader_objects();
+	}
 }
 
 void pipeline::update()
 {
 	VULKAN_ASSERT_NOT_NULL(m_handle);
-	VULKAN_ASSERT_NOT_NULL(m_device_handle);
-	vkDestroyPipeline(m_device_handle, m_handle, nullptr);
-	finalize();
+	assert_if(nullptr == m_device, "Pipeline must be built before it is updated");
+
+	/* Shader objects are bound without waiting for compiles, the frame has finished with the previous ones. */
+	if (m_specialization_changed && has_shader_objects())
+	{
+		build_shader_objects();
+	}
+	m_specialization_changed = false;
+	m_update_deferred = false;
+	/* Only library parts with changed state are compiled, the workers link them once they are. Changes to dynamic
+	 * state only keep the key, the current VkPipeline is ready to be swapped in right away. */
+	m_pending_desc = get_desc();
+	if (uses_libraries())
+	{
+		m_pending = m_device->m_pipeline_registry->request_linked_graphics_pipeline(
+		    *m_device, get_state_key(), get_library_keys(), m_pending_desc);
+	}
+	else
+	{
+		m_pending =
+		    m_device->m_pipeline_registry->request_graphics_pipeline(*m_device, get_state_key(), m_pending_desc);
+	}
+	m_device->m_pipeline_registry->add_pending(*this);
+}
+
+void pipeline::defer_update()
+{
+	if (!has_shader_objects())
+	{
+		update();
+		return;
+	}
+
+	if (m_specialization_changed)
+	{
+		build_shader_objects();
+		m_specialization_changed = false;
+	}
+	m_update_deferred = true;
+}
+
+void pipeline::flush_deferred_update()
+{
+	if (m_update_deferred)
+	{
+		update();
+	}
+}
+
+void compute_pipeline::add_shader(device &device, const char *path)
+{
+	assert_if(nullptr != m_shader_module, "Compute pipeline already has a shader");
+	m_shader_module = device.m_pipeline_registry->get_shader_module(device, VK_SHADER_STAGE_COMPUTE_BIT, path);
+	m_pipeline_layout.add_shader(*m_shader_module);
+}
+
+void compute_pipeline::build(device &device)
+{
+	assert_if(nullptr == m_shader_module, "Cannot build a compute pipeline without a shader");
+
+	m_pipeline_layout.build(device);
+
+	VkComputePipelineCreateInfo pipeline_info = {};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage = m_shader_module->get_pipeline_shader_stage_create_info();
+	pipeline_info.layout = m_pipeline_layout.m_handle;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_info.basePipelineIndex = -1;
+	pipeline_key key = {};
+	key.add(VK_SHADER_STAGE_COMPUTE_BIT);
+	key.add(m_shader_module);
+	m_shared = device.m_pipeline_registry->get_compute_pipeline(device, key, pipeline_info);
+	m_handle = m_shared->m_handle;
 }
 
 } /* namespace vulkan */
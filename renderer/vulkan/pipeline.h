@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -12,11 +13,14 @@
 #include <utils/util.h>
 
 #include "device.h"
+#include "pipeline_registry.h"
 #include "shader.h"
 
 namespace vulkan
 {
 
+class command_buffer;
+
 class pipeline_layout
 {
 public:
@@ -31,11 +35,27 @@ public:
 
 	VkPipelineLayout m_handle = {};
 	u32 m_push_constants_size = 0;
+	VkShaderStageFlags m_push_constants_stages = 0;
+	std::vector<VkDescriptorSetLayout> m_set_layouts = {};
+
+	/* Hash of the push constant range and the sets up to each index, 0 past the last set. Sets bound with one layout
+	 * stay bound with another as long as both have the same value at their index. */
+	std::array<u64, descriptor_set_count> m_set_compatibility = {};
 
 private:
+	/* Merged across stages, a binding is only visible to the stages that declare it. */
+	struct layout_binding
+	{
+		u32 set;
+		u32 binding;
+		VkDescriptorType type;
+		VkShaderStageFlags stages;
+	};
+
 	VkDevice m_device_handle = {};
-	std::vector<shader_resource_binding> m_resource_bindings = {};
-	descriptor_set_layout m_dset_layout = {};
+	VkShaderStageFlags m_stages = 0;
+	std::vector<layout_binding> m_resource_bindings = {};
+	std::array<descriptor_set_layout, descriptor_set_count> m_dset_layouts = {};
 };
 
 /* (TODO, thoave01): public no_copy_no_move inheritance. */
@@ -52,25 +72,90 @@ public:
 	void add_shader(device &device, VkShaderStageFlagBits stage, const char *path);
 	void add_shader(const ref<shader_module> &shader);
 
+	void set_vertex_attribute_format(u32 location, VkFormat format);
+	void set_vertex_attribute_binding(u32 location, u32 binding);
+	void set_vertex_binding_input_rate(u32 binding, VkVertexInputRate input_rate);
 	void set_sample_count(VkSampleCountFlagBits sample_count);
 	void set_topology(VkPrimitiveTopology topology);
 	void set_cull_mode(VkCullModeFlags cull_mode);
 	void set_blend_enable(VkBool32 blend_enable);
+	void set_color_write_mask(VkColorComponentFlags color_write_mask);
+	void set_depth_write_enable(VkBool32 depth_write_enable);
+	void set_depth_compare_op(VkCompareOp depth_compare_op);
 	void set_color_format(VkFormat format);
 	void set_depth_format(VkFormat format);
 
+	/* Overrides the default of a specialization constant in every stage that declares it. Booleans are VkBool32. */
+	void set_specialization_constant(u32 constant_id, u32 value);
+
 	void build(device &device);
+
+	/* Compiles the changed state on a worker thread. The current VkPipeline stays in use until the registry swaps
+	 * in the new one at a frame boundary, see pipeline_registry::swap_pending. */
 	void update();
 
+	/* Update while shader objects are bound instead of VkPipelines. They read the state when bound, so only
+	 * specialization changes are applied and the compile is deferred to flush_deferred_update. Pipelines without
+	 * shader objects are updated right away. */
+	void defer_update();
+	void flush_deferred_update();
+
+	/* Shaders and fixed-function state, pipelines with equal keys share their VkPipeline. */
+	pipeline_key get_state_key() const;
+
+	/* Binds the shader objects and sets all state a VkPipeline would have baked in, so that state changes need no
+	 * compile. Only vertex pipelines have shader objects, and only if the device supports them. */
+	bool has_shader_objects() const;
+	void bind_shader_objects(command_buffer &command_buffer) const;
+
+	/* Sets the dynamic state of the bound VkPipeline, except viewport and scissor. Pipelines that only differ in
+	 * dynamic state share their VkPipeline. State the command buffer already has is skipped. */
+	void set_dynamic_state(command_buffer &command_buffer) const;
+
+	/* Whether the VkPipeline leaves the state to be set dynamically instead of baking it in. */
+	bool has_dynamic_state(VkDynamicState dynamic_state) const;
+
 	VkPipeline m_handle = {};
 	pipeline_layout m_pipeline_layout = {};
 
 private:
-	void finalize();
+	friend class pipeline_registry;
 
-	VkDevice m_device_handle = {};
+	void build_vertex_input();
+	void build_shader_objects();
+	void finalize();
+	bool uses_libraries() const;
+	void add_shader_state(pipeline_key &key) const;
+	void add_dynamic_state(pipeline_key &key) const;
+	graphics_pipeline_library_keys get_library_keys() const;
+	ref<graphics_pipeline_desc> get_desc() const;
+	void swap_pending();
+	bool is_dynamic(VkDynamicState dynamic_state) const;
+
+	/* Records one dynamic state from either the pipeline or a graphics_pipeline_desc, they share member names. Equal
+	 * values from get_state record equal state. */
+	template <typename T>
+	static u64 get_state(VkDynamicState dynamic_state, const T &state);
+	template <typename T>
+	static void set_state(VkCommandBuffer command_buffer, VkDynamicState dynamic_state, const T &state);
+
+	device *m_device = nullptr;
+	ref<shared_pipeline> m_shared = {};
+	ref<shared_pipeline> m_pending = {};
+	/* State m_shared and m_pending were compiled with, dynamic state is set from it. */
+	ref<graphics_pipeline_desc> m_desc = {};
+	ref<graphics_pipeline_desc> m_pending_desc = {};
 	std::unordered_map<VkShaderStageFlagBits, ref<shader_module>> m_shader_modules = {};
 
+	std::map<u32, VkFormat> m_vertex_attribute_formats = {};
+	std::map<u32, u32> m_vertex_attribute_bindings = {};
+	std::map<u32, VkVertexInputRate> m_vertex_binding_input_rates = {};
+	std::vector<VkVertexInputBindingDescription> m_vbds = {};
+	std::vector<VkVertexInputAttributeDescription> m_vads = {};
+	std::map<u32, u32> m_specialization_constants = {};
+	bool m_specialization_changed = false;
+	bool m_update_deferred = false;
+
 	VkPipelineVertexInputStateCreateInfo m_vertex_input_info;
 	VkPipelineInputAssemblyStateCreateInfo m_input_assembly;
 	VkPipelineViewportStateCreateInfo m_viewport_info;
@@ -86,6 +171,30 @@ private:
 
 	VkFormat m_color_format = {};
 	VkPipelineRenderingCreateInfo m_rendering_info = {};
+
+	std::vector<uref<shader_object>> m_shader_objects = {};
+	std::vector<VkVertexInputBindingDescription2EXT> m_vertex_binding_descriptions = {};
+	std::vector<VkVertexInputAttributeDescription2EXT> m_vertex_attribute_descriptions = {};
+};
+
+class compute_pipeline
+{
+public:
+	compute_pipeline() = default;
+	~compute_pipeline() = default;
+
+	compute_pipeline(const compute_pipeline &) = delete;
+	compute_pipeline operator=(const compute_pipeline &) = delete;
+
+	void add_shader(device &device, const char *path);
+	void build(device &device);
+
+	VkPipeline m_handle = {};
+	pipeline_layout m_pipeline_layout = {};
+
+private:
+	ref<shader_module> m_shader_module = {};
+	ref<shared_pipeline> m_shared = {};
 };
 
 } /* namespace vulkan */
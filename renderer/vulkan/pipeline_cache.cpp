@@ -0,0 +1,197 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+#include <utils/log.h>
+#include <utils/util.h>
+
+#include "pipeline_cache.h"
+#include "util.h"
+
+namespace vulkan
+{
+
+/* Prefixed to the driver's cache data, which only carries vendor, device and cache UUID in its own header. Written
+ * and read as raw bytes, so it must have no padding. */
+struct pipeline_cache_file_header
+{
+	u32 magic;
+	u32 version;
+	u32 vendor_id;
+	u32 device_id;
+	u32 driver_version;
+	u8 pipeline_cache_uuid[VK_UUID_SIZE];
+	u32 reserved; /* Zero, aligns data_size. */
+	u64 data_size;
+	u64 data_hash;
+};
+static_assert(std::has_unique_object_representations_v<pipeline_cache_file_header>,
+              "Pipeline cache file header must not have padding");
+
+static constexpr u32 pipeline_cache_magic = 0x4c415043; /* "CPAL". */
+static constexpr u32 pipeline_cache_version = 2;
+
+static u64 hash_data(const u8 *data, size_t size)
+{
+	/* Eight bytes at a time, the tail is zero-extended into a last word. */
+	u64 hash = hash_combine(0, size);
+	size_t i = 0;
+	for (; i + sizeof(u64) <= size; i += sizeof(u64))
+	{
+		u64 word = 0;
+		memcpy(&word, data + i, sizeof(word));
+		hash = hash_combine(hash, word);
+	}
+	if (i < size)
+	{
+		u64 word = 0;
+		memcpy(&word, data + i, size - i);
+		hash = hash_combine(hash, word);
+	}
+	return hash;
+}
+
+static pipeline_cache_file_header get_file_header(const VkPhysicalDeviceProperties &properties)
+{
+	pipeline_cache_file_header header = {};
+	header.magic = pipeline_cache_magic;
+	header.version = pipeline_cache_version;
+	header.vendor_id = properties.vendorID;
+	header.device_id = properties.deviceID;
+	header.driver_version = properties.driverVersion;
+	memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	return header;
+}
+
+/* Returns the driver's cache data if the file was written by this device and driver, empty otherwise. */
+static std::vector<u8> load_cache_data(const char *path, const VkPhysicalDeviceProperties &properties)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return {};
+	}
+	const std::vector<u8> file_data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	pipeline_cache_file_header header = {};
+	if (file_data.size() < sizeof(header))
+	{
+		logger::warn("Pipeline cache %s is truncated, ignoring it", path);
+		return {};
+	}
+	memcpy(&header, file_data.data(), sizeof(header));
+
+	const pipeline_cache_file_header expected = get_file_header(properties);
+	if (header.magic != expected.magic || header.version != expected.version ||
+	    header.vendor_id != expected.vendor_id || header.device_id != expected.device_id ||
+	    header.driver_version != expected.driver_version ||
+	    0 != memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE))
+	{
+		logger::info("Pipeline cache %s was written by another device or driver, ignoring it", path);
+		return {};
+	}
+
+	const u8 *data = file_data.data() + sizeof(header);
+	if (header.data_size != file_data.size() - sizeof(header) || header.data_hash != hash_data(data, header.data_size))
+	{
+		logger::warn("Pipeline cache %s is corrupt, ignoring it", path);
+		return {};
+	}
+
+	/* The driver header must agree with ours as well. */
+	VkPipelineCacheHeaderVersionOne driver_header = {};
+	if (header.data_size < sizeof(driver_header))
+	{
+		return {};
+	}
+	memcpy(&driver_header, data, sizeof(driver_header));
+	if (driver_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+	    driver_header.vendorID != properties.vendorID || driver_header.deviceID != properties.deviceID ||
+	    0 != memcmp(driver_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE))
+	{
+		logger::warn("Pipeline cache %s has an unexpected driver header, ignoring it", path);
+		return {};
+	}
+
+	return std::vector<u8>(data, data + header.data_size);
+}
+
+pipeline_cache::~pipeline_cache()
+{
+	if (VK_NULL_HANDLE != m_handle)
+	{
+		save();
+		vkDestroyPipelineCache(m_device_handle, m_handle, nullptr);
+	}
+}
+
+void pipeline_cache::build(device &device, const char *path)
+{
+	m_path = path;
+	vkGetPhysicalDeviceProperties(device.m_physical.m_handle, &m_device_properties);
+
+	const std::vector<u8> data = load_cache_data(path, m_device_properties);
+	if (!data.empty())
+	{
+		logger::info("Loaded %zu bytes of pipeline cache from %s", data.size(), path);
+	}
+
+	VkPipelineCacheCreateInfo pipeline_cache_info = {};
+	pipeline_cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipeline_cache_info.initialDataSize = data.size();
+	pipeline_cache_info.pInitialData = data.empty() ? nullptr : data.data();
+	VULKAN_ASSERT_SUCCESS(
+	    vkCreatePipelineCache(device.m_logical.m_handle, &pipeline_cache_info, nullptr, &m_handle));
+
+	m_device_handle = device.m_logical.m_handle;
+}
+
+void pipeline_cache::save()
+{
+	size_t size = 0;
+	VULKAN_ASSERT_SUCCESS(vkGetPipelineCacheData(m_device_handle, m_handle, &size, nullptr));
+	std::vector<u8> data(size);
+	VULKAN_ASSERT_SUCCESS(vkGetPipelineCacheData(m_device_handle, m_handle, &size, data.data()));
+	data.resize(size);
+
+	pipeline_cache_file_header header = get_file_header(m_device_properties);
+	header.data_size = data.size();
+	header.data_hash = hash_data(data.data(), data.size());
+
+	/* Write next to the cache and rename over it, so a crash never leaves a partial file behind. The data is synced
+	 * first, otherwise the rename may reach the disk before it does. */
+	const std::string temporary_path = m_path + ".tmp";
+	FILE *file = fopen(temporary_path.c_str(), "wb");
+	if (nullptr == file)
+	{
+		logger::warn("Could not open pipeline cache %s", temporary_path.c_str());
+		return;
+	}
+	const bool written = 1 == fwrite(&header, sizeof(header), 1, file) &&
+	                     data.size() == fwrite(data.data(), 1, data.size(), file) && 0 == fflush(file) &&
+	                     0 == fsync(fileno(file));
+	if (0 != fclose(file) || !written)
+	{
+		logger::warn("Could not write pipeline cache %s", temporary_path.c_str());
+		std::error_code error = {};
+		std::filesystem::remove(temporary_path, error);
+		return;
+	}
+
+	std::error_code error = {};
+	std::filesystem::rename(temporary_path, m_path, error);
+	if (error)
+	{
+		logger::warn("Could not replace pipeline cache %s: %s", m_path.c_str(), error.message().c_str());
+		std::filesystem::remove(temporary_path, error);
+		return;
+	}
+	logger::info("Saved %zu bytes of pipeline cache to %s", data.size(), m_path.c_str());
+}
+
+} /* namespace vulkan */
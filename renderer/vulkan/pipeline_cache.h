@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <third_party/volk/volk.h>
+#pragma clang diagnostic pop
+
+#include <utils/type.h>
+
+#include "device.h"
+
+namespace vulkan
+{
+
+/* Device-wide VkPipelineCache persisted to disk. The file is only loaded if it was written by the same vendor, device,
+ * driver and pipeline cache UUID, and is replaced atomically when the cache is saved. */
+class pipeline_cache
+{
+public:
+	pipeline_cache() = default;
+	~pipeline_cache();
+
+	pipeline_cache(const pipeline_cache &) = delete;
+	pipeline_cache operator=(const pipeline_cache &) = delete;
+
+	void build(device &device, const char *path);
+	void save();
+
+	VkPipelineCache m_handle = {};
+
+private:
+	VkDevice m_device_handle = {};
+	VkPhysicalDeviceProperties m_device_properties = {};
+	std::string m_path = {};
+};
+
+} /* namespace vulkan */
@@ -0,0 +1,605 @@
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <string_view>
+
+#include <platform/file.h>
+#include <utils/util.h>
+
+#include "pipeline.h"
+#include "pipeline_registry.h"
+#include "util.h"
+
+namespace vulkan
+{
+
+void pipeline_key::add(u64 value)
+{
+	m_words.push_back(value);
+	m_hash = hash_combine(m_hash, value);
+}
+
+void pipeline_key::add(const ref<shader_module> &shader)
+{
+	m_shaders.push_back(shader);
+	m_hash = hash_combine(m_hash, shader->m_hash);
+}
+
+void pipeline_key::add(const pipeline_key &key)
+{
+	m_words.insert(m_words.end(), key.m_words.begin(), key.m_words.end());
+	m_shaders.insert(m_shaders.end(), key.m_shaders.begin(), key.m_shaders.end());
+	m_hash = hash_combine(m_hash, key.m_hash);
+}
+
+bool pipeline_key::operator==(const pipeline_key &other) const
+{
+	return m_hash == other.m_hash && m_words == other.m_words && m_shaders == other.m_shaders;
+}
+
+shared_pipeline::~shared_pipeline()
+{
+	if (VK_NULL_HANDLE != m_handle)
+	{
+		vkDestroyPipeline(m_device_handle, m_handle, nullptr);
+	}
+}
+
+bool shared_pipeline::is_ready() const
+{
+	return m_ready.load(std::memory_order_acquire);
+}
+
+void graphics_pipeline_desc::link()
+{
+	/* All stages share the constants, entries a stage does not declare are ignored. */
+	m_specialization_info = {};
+	m_specialization_info.mapEntryCount = m_specialization_entries.size();
+	m_specialization_info.pMapEntries = m_specialization_entries.data();
+	m_specialization_info.dataSize = m_specialization_data.size() * sizeof(u32);
+	m_specialization_info.pData = m_specialization_data.data();
+
+	m_stage_create_infos.clear();
+	for (const ref<shader_module> &shader : m_shader_modules)
+	{
+		m_stage_create_infos.push_back(shader->get_pipeline_shader_stage_create_info());
+		if (!m_specialization_entries.empty())
+		{
+			m_stage_create_infos.back().pSpecializationInfo = &m_specialization_info;
+		}
+	}
+
+	m_vertex_input_info = {};
+	m_vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	if (m_vads.size() != 0)
+	{
+		m_vertex_input_info.vertexBindingDescriptionCount = m_vbds.size();
+		m_vertex_input_info.pVertexBindingDescriptions = m_vbds.data();
+		m_vertex_input_info.vertexAttributeDescriptionCount = m_vads.size();
+		m_vertex_input_info.pVertexAttributeDescriptions = m_vads.data();
+	}
+	m_blending_info.pAttachments = &m_blend_attachment_state;
+	m_dynamic_state_info.dynamicStateCount = m_dynamic_states.size();
+	m_dynamic_state_info.pDynamicStates = m_dynamic_states.data();
+	m_rendering_info.pColorAttachmentFormats = &m_color_format;
+
+	m_info = {};
+	m_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	m_info.pNext = &m_rendering_info;
+	m_info.stageCount = m_stage_create_infos.size();
+	m_info.pStages = m_stage_create_infos.data();
+	/* Mesh pipelines generate their own primitives. */
+	m_info.pVertexInputState = m_mesh ? nullptr : &m_vertex_input_info;
+	m_info.pInputAssemblyState = m_mesh ? nullptr : &m_input_assembly;
+	m_info.pViewportState = &m_viewport_info;
+	m_info.pRasterizationState = &m_rasterizer_info;
+	m_info.pMultisampleState = &m_multisampling_info;
+	m_info.pDepthStencilState = &m_depth_stencil_info;
+	m_info.pColorBlendState = &m_blending_info;
+	m_info.pDynamicState = &m_dynamic_state_info;
+	m_info.layout = m_layout;
+	m_info.renderPass = VK_NULL_HANDLE;
+	m_info.subpass = 0;
+	m_info.basePipelineHandle = VK_NULL_HANDLE;
+	m_info.basePipelineIndex = -1;
+}
+
+static void link_libraries(VkDevice device_handle, VkPipelineCache cache,
+                           const std::vector<ref<shared_pipeline>> &libraries, VkPipelineLayout layout,
+                           VkPipelineCreateFlags flags, VkPipeline *handle)
+{
+	std::vector<VkPipeline> library_handles = {};
+	for (const ref<shared_pipeline> &library : libraries)
+	{
+		library_handles.push_back(library->m_handle);
+	}
+
+	VkPipelineLibraryCreateInfoKHR library_info = {};
+	library_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	library_info.libraryCount = library_handles.size();
+	library_info.pLibraries = library_handles.data();
+
+	VkGraphicsPipelineCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	info.pNext = &library_info;
+	info.flags = flags;
+	info.layout = layout;
+	info.basePipelineHandle = VK_NULL_HANDLE;
+	info.basePipelineIndex = -1;
+	VULKAN_ASSERT_SUCCESS(vkCreateGraphicsPipelines(device_handle, cache, 1, &info, nullptr, handle));
+}
+
+static void create_library(VkDevice device_handle, VkPipelineCache cache, VkGraphicsPipelineLibraryFlagsEXT part,
+                           const graphics_pipeline_desc &desc, VkPipeline *handle)
+{
+	/* Each part only takes the state it owns, the pipeline layout is shared by both shader parts. */
+	std::vector<VkPipelineShaderStageCreateInfo> stages = {};
+	VkGraphicsPipelineCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	info.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+	info.pDynamicState = &desc.m_dynamic_state_info;
+	info.basePipelineHandle = VK_NULL_HANDLE;
+	info.basePipelineIndex = -1;
+	switch (part)
+	{
+	case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+		info.pVertexInputState = &desc.m_vertex_input_info;
+		info.pInputAssemblyState = &desc.m_input_assembly;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+		std::copy_if(desc.m_stage_create_infos.begin(), desc.m_stage_create_infos.end(), std::back_inserter(stages),
+		             [](const VkPipelineShaderStageCreateInfo &stage)
+		             { return VK_SHADER_STAGE_FRAGMENT_BIT != stage.stage; });
+		info.pViewportState = &desc.m_viewport_info;
+		info.pRasterizationState = &desc.m_rasterizer_info;
+		info.layout = desc.m_layout;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+		std::copy_if(desc.m_stage_create_infos.begin(), desc.m_stage_create_infos.end(), std::back_inserter(stages),
+		             [](const VkPipelineShaderStageCreateInfo &stage)
+		             { return VK_SHADER_STAGE_FRAGMENT_BIT == stage.stage; });
+		info.pDepthStencilState = &desc.m_depth_stencil_info;
+		info.layout = desc.m_layout;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+		info.pColorBlendState = &desc.m_blending_info;
+		info.pMultisampleState = &desc.m_multisampling_info;
+		break;
+	default:
+		assert_if(true, "Unknown graphics pipeline library part %u", part);
+	}
+	info.stageCount = stages.size();
+	info.pStages = stages.data();
+
+	VkPipelineRenderingCreateInfo rendering_info = desc.m_rendering_info;
+	VkGraphicsPipelineLibraryCreateInfoEXT library_info = {};
+	library_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	library_info.pNext = &rendering_info;
+	library_info.flags = part;
+	info.pNext = &library_info;
+
+	VULKAN_ASSERT_SUCCESS(vkCreateGraphicsPipelines(device_handle, cache, 1, &info, nullptr, handle));
+}
+
+pipeline_registry::pipeline_registry()
+{
+	/* Leave a core for the main thread, compiles are rare enough that a few workers suffice. */
+	const u32 worker_count = std::clamp(std::thread::hardware_concurrency(), 2u, 5u) - 1;
+	for (u32 i = 0; i < worker_count; ++i)
+	{
+		m_workers.emplace_back(&pipeline_registry::work, this);
+	}
+}
+
+pipeline_registry::~pipeline_registry()
+{
+	/* Queued compiles are finished, their pipelines may still be waited on. */
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_job_condition.notify_all();
+	for (std::thread &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+ref<shader_module> pipeline_registry::get_shader_module(device &device, VkShaderStageFlagBits stage,
+                                                        const char *path)
+{
+	++m_statistics.shader_requests;
+
+	/* Embedded shaders need no file access or reflection. Mapping and hashing a file is cheap next to reflection and
+	 * module creation, a changed file gets a new module. */
+	const embedded_shader *embedded = find_embedded_shader(path);
+	mapped_file file = {};
+	std::span<const u32> code = {};
+	u64 hash = 0;
+	if (nullptr != embedded)
+	{
+		assert_if(embedded->m_stage != stage, "Shader %s was embedded for another stage", path);
+		code = embedded->m_code;
+		hash = embedded->m_hash;
+	}
+	else
+	{
+		assert_if(!file.build(path), "Could not open shader %s", path);
+		code = std::span<const u32>(reinterpret_cast<const u32 *>(file.m_data), file.m_size / sizeof(u32));
+		hash = hash_shader_code(code);
+	}
+	u64 key = hash_combine(std::hash<std::string_view>()(path), stage);
+	key = hash_combine(key, hash);
+	if (ref<shader_module> shader = m_shader_modules[key].lock())
+	{
+		return shader;
+	}
+
+	ref<shader_module> shader = make_ref<shader_module>();
+	if (nullptr != embedded)
+	{
+		shader->build(device, *embedded);
+	}
+	else
+	{
+		shader->build(device, stage, path, code, hash);
+	}
+	m_shader_modules[key] = shader;
+	++m_statistics.shader_compiles;
+	return shader;
+}
+
+ref<shared_pipeline> pipeline_registry::find(pipeline_map &map, const pipeline_key &key)
+{
+	/* Destroyed pipelines are dropped from the bucket on the way, workers may release the last reference anytime. */
+	std::vector<std::weak_ptr<shared_pipeline>> &bucket = map[key.m_hash];
+	std::erase_if(bucket, [](const std::weak_ptr<shared_pipeline> &pipeline) { return pipeline.expired(); });
+	for (const std::weak_ptr<shared_pipeline> &entry : bucket)
+	{
+		ref<shared_pipeline> pipeline = entry.lock();
+		if (nullptr != pipeline && pipeline->m_key == key)
+		{
+			return pipeline;
+		}
+	}
+	return nullptr;
+}
+
+void pipeline_registry::insert(pipeline_map &map, const ref<shared_pipeline> &pipeline)
+{
+	map[pipeline->m_key.m_hash].push_back(pipeline);
+}
+
+ref<shared_pipeline> pipeline_registry::get_graphics_pipeline(device &device, const pipeline_key &key,
+                                                              const graphics_pipeline_desc &desc)
+{
+	++m_statistics.pipeline_requests;
+	if (ref<shared_pipeline> pipeline = find(m_pipelines, key))
+	{
+		wait(*pipeline);
+		return pipeline;
+	}
+
+	ref<shared_pipeline> pipeline = make_ref<shared_pipeline>();
+	VULKAN_ASSERT_SUCCESS(vkCreateGraphicsPipelines(device.m_logical.m_handle, device.m_pipeline_cache, 1, &desc.m_info,
+	                                                nullptr, &pipeline->m_handle));
+	pipeline->m_device_handle = device.m_logical.m_handle;
+	pipeline->m_ready.store(true, std::memory_order_release);
+	pipeline->m_key = key;
+	insert(m_pipelines, pipeline);
+	++m_statistics.pipeline_compiles;
+	return pipeline;
+}
+
+ref<shared_pipeline> pipeline_registry::get_compute_pipeline(device &device, const pipeline_key &key,
+                                                             const VkComputePipelineCreateInfo &info)
+{
+	++m_statistics.pipeline_requests;
+	if (ref<shared_pipeline> pipeline = find(m_pipelines, key))
+	{
+		return pipeline;
+	}
+
+	ref<shared_pipeline> pipeline = make_ref<shared_pipeline>();
+	VULKAN_ASSERT_SUCCESS(vkCreateComputePipelines(device.m_logical.m_handle, device.m_pipeline_cache, 1, &info,
+	                                               nullptr, &pipeline->m_handle));
+	pipeline->m_device_handle = device.m_logical.m_handle;
+	pipeline->m_ready.store(true, std::memory_order_release);
+	pipeline->m_key = key;
+	insert(m_pipelines, pipeline);
+	++m_statistics.pipeline_compiles;
+	return pipeline;
+}
+
+ref<shared_pipeline> pipeline_registry::request_graphics_pipeline(device &device, const pipeline_key &key,
+                                                                  const ref<graphics_pipeline_desc> &desc)
+{
+	++m_statistics.pipeline_requests;
+	if (ref<shared_pipeline> pipeline = find(m_pipelines, key))
+	{
+		return pipeline;
+	}
+
+	ref<shared_pipeline> pipeline = make_ref<shared_pipeline>();
+	pipeline->m_device_handle = device.m_logical.m_handle;
+	pipeline->m_key = key;
+	insert(m_pipelines, pipeline);
+	++m_statistics.pipeline_compiles;
+	submit({ .m_pipeline = pipeline,
+	         .m_desc = desc,
+	         .m_libraries = {},
+	         .m_part = 0,
+	         .m_flags = 0,
+	         .m_cache = device.m_pipeline_cache });
+	return pipeline;
+}
+
+ref<shared_pipeline> pipeline_registry::get_library(device &device, pipeline_key key,
+                                                    VkGraphicsPipelineLibraryFlagsEXT part,
+                                                    const ref<graphics_pipeline_desc> &desc, bool async)
+{
+	key.add(part);
+	if (ref<shared_pipeline> library = find(m_libraries, key))
+	{
+		return library;
+	}
+
+	ref<shared_pipeline> library = make_ref<shared_pipeline>();
+	library->m_device_handle = device.m_logical.m_handle;
+	library->m_key = std::move(key);
+	insert(m_libraries, library);
+	++m_statistics.library_compiles;
+	if (async)
+	{
+		submit({ .m_pipeline = library,
+		         .m_desc = desc,
+		         .m_libraries = {},
+		         .m_part = part,
+		         .m_flags = 0,
+		         .m_cache = device.m_pipeline_cache });
+	}
+	else
+	{
+		create_library(device.m_logical.m_handle, device.m_pipeline_cache, part, *desc, &library->m_handle);
+		library->m_ready.store(true, std::memory_order_release);
+	}
+	return library;
+}
+
+std::vector<ref<shared_pipeline>> pipeline_registry::get_libraries(device &device,
+                                                                   const graphics_pipeline_library_keys &keys,
+                                                                   const ref<graphics_pipeline_desc> &desc, bool async)
+{
+	return {
+		get_library(device, keys.vertex_input, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, desc,
+		            async),
+		get_library(device, keys.pre_rasterization, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		            desc, async),
+		get_library(device, keys.fragment_shader, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, desc, async),
+		get_library(device, keys.fragment_output, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, desc,
+		            async),
+	};
+}
+
+void pipeline_registry::submit_optimized_link(device &device, shared_pipeline &pipeline,
+                                              const ref<graphics_pipeline_desc> &desc)
+{
+	if (m_optimize_links)
+	{
+		pipeline.m_optimized = make_ref<shared_pipeline>();
+		pipeline.m_optimized->m_device_handle = device.m_logical.m_handle;
+		pipeline.m_optimized->m_key = pipeline.m_key;
+		pipeline.m_optimized->m_libraries = pipeline.m_libraries;
+		submit({ .m_pipeline = pipeline.m_optimized,
+		         .m_desc = desc,
+		         .m_libraries = pipeline.m_libraries,
+		         .m_part = 0,
+		         .m_flags = VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT,
+		         .m_cache = device.m_pipeline_cache });
+	}
+}
+
+ref<shared_pipeline> pipeline_registry::link_graphics_pipeline(device &device, const pipeline_key &key,
+                                                               const graphics_pipeline_library_keys &keys,
+                                                               const ref<graphics_pipeline_desc> &desc)
+{
+	++m_statistics.pipeline_requests;
+	if (ref<shared_pipeline> pipeline = find(m_pipelines, key))
+	{
+		wait(*pipeline);
+		return pipeline;
+	}
+
+	/* Parts requested asynchronously may still be compiling. */
+	ref<shared_pipeline> pipeline = make_ref<shared_pipeline>();
+	pipeline->m_libraries = get_libraries(device, keys, desc, false);
+	for (const ref<shared_pipeline> &library : pipeline->m_libraries)
+	{
+		wait(*library);
+	}
+	link_libraries(device.m_logical.m_handle, device.m_pipeline_cache, pipeline->m_libraries, desc->m_layout, 0,
+	               &pipeline->m_handle);
+	pipeline->m_device_handle = device.m_logical.m_handle;
+	pipeline->m_ready.store(true, std::memory_order_release);
+	pipeline->m_key = key;
+	insert(m_pipelines, pipeline);
+	++m_statistics.pipeline_compiles;
+	submit_optimized_link(device, *pipeline, desc);
+	return pipeline;
+}
+
+ref<shared_pipeline> pipeline_registry::request_linked_graphics_pipeline(device &device, const pipeline_key &key,
+                                                                         const graphics_pipeline_library_keys &keys,
+                                                                         const ref<graphics_pipeline_desc> &desc)
+{
+	++m_statistics.pipeline_requests;
+	if (ref<shared_pipeline> pipeline = find(m_pipelines, key))
+	{
+		return pipeline;
+	}
+
+	/* Missing parts are submitted before the links that wait for them. */
+	ref<shared_pipeline> pipeline = make_ref<shared_pipeline>();
+	pipeline->m_device_handle = device.m_logical.m_handle;
+	pipeline->m_key = key;
+	pipeline->m_libraries = get_libraries(device, keys, desc, true);
+	insert(m_pipelines, pipeline);
+	++m_statistics.pipeline_compiles;
+	submit({ .m_pipeline = pipeline,
+	         .m_desc = desc,
+	         .m_libraries = pipeline->m_libraries,
+	         .m_part = 0,
+	         .m_flags = 0,
+	         .m_cache = device.m_pipeline_cache });
+	submit_optimized_link(device, *pipeline, desc);
+	return pipeline;
+}
+
+void pipeline_registry::submit(compile_job &&job)
+{
+	/* Pipeline caches are internally synchronized, workers share the device-wide cache. */
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_job_condition.notify_one();
+}
+
+void pipeline_registry::add_pending(pipeline &pipeline)
+{
+	if (std::find(m_pending.begin(), m_pending.end(), &pipeline) == m_pending.end())
+	{
+		m_pending.push_back(&pipeline);
+	}
+}
+
+void pipeline_registry::remove_pending(pipeline &pipeline)
+{
+	std::erase(m_pending, &pipeline);
+	std::erase(m_unoptimized, &pipeline);
+}
+
+void pipeline_registry::add_unoptimized(pipeline &pipeline)
+{
+	if (nullptr != pipeline.m_shared->m_optimized &&
+	    std::find(m_unoptimized.begin(), m_unoptimized.end(), &pipeline) == m_unoptimized.end())
+	{
+		m_unoptimized.push_back(&pipeline);
+	}
+}
+
+bool pipeline_registry::swap_pending()
+{
+	/* Optimized links have the same state as their fast links, they are swapped in one by one. */
+	m_handles_swapped = false;
+	std::erase_if(m_unoptimized,
+	              [&](pipeline *pipeline)
+	              {
+		              const ref<shared_pipeline> optimized = pipeline->m_shared->m_optimized;
+		              if (nullptr == optimized)
+		              {
+			              return true;
+		              }
+		              if (!optimized->is_ready())
+		              {
+			              return false;
+		              }
+		              for (std::weak_ptr<shared_pipeline> &entry : m_pipelines[optimized->m_key.m_hash])
+		              {
+			              if (entry.lock() == pipeline->m_shared)
+			              {
+				              entry = optimized;
+			              }
+		              }
+		              pipeline->m_shared = optimized;
+		              pipeline->m_handle = optimized->m_handle;
+		              m_handles_swapped = true;
+		              return true;
+	              });
+
+	m_statistics.pipelines_pending = 0;
+	for (const pipeline *pipeline : m_pending)
+	{
+		if (!pipeline->m_pending->is_ready())
+		{
+			++m_statistics.pipelines_pending;
+		}
+	}
+	if (0 != m_statistics.pipelines_pending)
+	{
+		return false;
+	}
+
+	for (pipeline *pipeline : m_pending)
+	{
+		pipeline->swap_pending();
+		add_unoptimized(*pipeline);
+		m_handles_swapped = true;
+	}
+	m_pending.clear();
+	return true;
+}
+
+void pipeline_registry::wait(const shared_pipeline &pipeline)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done_condition.wait(lock, [&]() { return pipeline.is_ready(); });
+}
+
+void pipeline_registry::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done_condition.wait(lock, [&]() { return m_jobs.empty() && 0 == m_active_jobs; });
+}
+
+void pipeline_registry::work()
+{
+	for (;;)
+	{
+		compile_job job = {};
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_job_condition.wait(lock, [&]() { return m_stop || !m_jobs.empty(); });
+			if (m_jobs.empty())
+			{
+				return;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			++m_active_jobs;
+		}
+
+		if (0 != job.m_part)
+		{
+			create_library(job.m_pipeline->m_device_handle, job.m_cache, job.m_part, *job.m_desc,
+			               &job.m_pipeline->m_handle);
+		}
+		else if (job.m_libraries.empty())
+		{
+			VULKAN_ASSERT_SUCCESS(vkCreateGraphicsPipelines(job.m_pipeline->m_device_handle, job.m_cache, 1,
+			                                                &job.m_desc->m_info, nullptr, &job.m_pipeline->m_handle));
+		}
+		else
+		{
+			/* Libraries are submitted before their links, so they are compiled or being compiled by now. */
+			for (const ref<shared_pipeline> &library : job.m_libraries)
+			{
+				wait(*library);
+			}
+			link_libraries(job.m_pipeline->m_device_handle, job.m_cache, job.m_libraries, job.m_desc->m_layout,
+			               job.m_flags, &job.m_pipeline->m_handle);
+		}
+
+		/* Released before notifying, the description references the requesting pipeline's layout. */
+		job.m_desc = nullptr;
+		job.m_libraries.clear();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			job.m_pipeline->m_ready.store(true, std::memory_order_release);
+			--m_active_jobs;
+		}
+		m_done_condition.notify_all();
+	}
+}
+
+} /* namespace vulkan */
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <third_party/volk/volk.h>
+#pragma clang diagnostic pop
+
+#include <utils/type.h>
+
+#include "device.h"
+#include "shader.h"
+
+namespace vulkan
+{
+
+class pipeline;
+
+/* Full state a pipeline or pipeline library part is created with. Shader modules are deduplicated by the registry and
+ * compared by identity, the key references them so that their addresses are not reused while it lives. The hash only
+ * selects a bucket, lookups compare the whole key. */
+struct pipeline_key
+{
+	void add(u64 value);
+	void add(const ref<shader_module> &shader);
+	void add(const pipeline_key &key);
+	bool operator==(const pipeline_key &other) const;
+
+	std::vector<u64> m_words = {};
+	std::vector<ref<shader_module>> m_shaders = {};
+	u64 m_hash = 0;
+};
+
+/* VkPipeline shared by all pipelines with the same state key, destroyed with its last reference. */
+class shared_pipeline
+{
+public:
+	shared_pipeline() = default;
+	~shared_pipeline();
+
+	shared_pipeline(const shared_pipeline &) = delete;
+	shared_pipeline operator=(const shared_pipeline &) = delete;
+
+	/* Set once m_handle has been created, possibly on a worker thread. */
+	bool is_ready() const;
+
+	VkPipeline m_handle = {};
+
+private:
+	friend class pipeline_registry;
+
+	VkDevice m_device_handle = {};
+	std::atomic<bool> m_ready = false;
+
+	/* Linked pipelines keep their libraries cached, and fast links are replaced by an optimized link. */
+	pipeline_key m_key = {};
+	std::vector<ref<shared_pipeline>> m_libraries = {};
+	ref<shared_pipeline> m_optimized = {};
+};
+
+/* Graphics pipeline state that owns everything its create info points to, so that it can be compiled on a worker
+ * thread while the pipeline it was taken from keeps changing. */
+struct graphics_pipeline_desc
+{
+	graphics_pipeline_desc() = default;
+	~graphics_pipeline_desc() = default;
+
+	graphics_pipeline_desc(const graphics_pipeline_desc &) = delete;
+	graphics_pipeline_desc operator=(const graphics_pipeline_desc &) = delete;
+
+	/* Points m_info at the members, called once they are filled in. */
+	void link();
+
+	std::vector<ref<shader_module>> m_shader_modules = {};
+	std::vector<VkPipelineShaderStageCreateInfo> m_stage_create_infos = {};
+	std::vector<VkVertexInputBindingDescription> m_vbds = {};
+	std::vector<VkVertexInputAttributeDescription> m_vads = {};
+	std::vector<VkDynamicState> m_dynamic_states = {};
+	std::vector<VkSpecializationMapEntry> m_specialization_entries = {};
+	std::vector<u32> m_specialization_data = {};
+	bool m_mesh = false;
+
+	VkPipelineVertexInputStateCreateInfo m_vertex_input_info = {};
+	VkPipelineInputAssemblyStateCreateInfo m_input_assembly = {};
+	VkPipelineViewportStateCreateInfo m_viewport_info = {};
+	VkPipelineRasterizationStateCreateInfo m_rasterizer_info = {};
+	VkPipelineMultisampleStateCreateInfo m_multisampling_info = {};
+	VkPipelineDepthStencilStateCreateInfo m_depth_stencil_info = {};
+	VkPipelineColorBlendAttachmentState m_blend_attachment_state = {};
+	VkPipelineColorBlendStateCreateInfo m_blending_info = {};
+	VkPipelineDynamicStateCreateInfo m_dynamic_state_info = {};
+	VkSpecializationInfo m_specialization_info = {};
+	VkFormat m_color_format = {};
+	VkPipelineRenderingCreateInfo m_rendering_info = {};
+	VkPipelineLayout m_layout = {};
+
+	VkGraphicsPipelineCreateInfo m_info = {};
+};
+
+/* State of each graphics pipeline library part, see VkGraphicsPipelineLibraryFlagBitsEXT. */
+struct graphics_pipeline_library_keys
+{
+	pipeline_key vertex_input;
+	pipeline_key pre_rasterization;
+	pipeline_key fragment_shader;
+	pipeline_key fragment_output;
+};
+
+struct pipeline_registry_statistics
+{
+	u32 pipeline_requests;
+	u32 pipeline_compiles;
+	u32 library_compiles;
+	u32 shader_requests;
+	u32 shader_compiles;
+	u32 pipelines_pending;
+};
+
+/* Deduplicates shader modules by stage, path and SPIR-V hash, and pipelines by the key of their shaders and
+ * fixed-function state. The registry only keeps weak references, so modules and pipelines are destroyed once no
+ * pipeline uses them. The pipeline layout is not part of the key, pipelines with equal shaders reflect identical
+ * layouts.
+ *
+ * Graphics pipelines can also be requested asynchronously, they are then compiled by worker threads and swapped into
+ * the pipelines that requested them by swap_pending.
+ *
+ * With graphics pipeline libraries, pipelines are instead fast-linked from four separately cached library parts, so
+ * that e.g. a new sample count only compiles a fragment output part. Optimized links are made by the workers and
+ * replace the fast links in swap_pending. */
+class pipeline_registry
+{
+public:
+	pipeline_registry();
+	~pipeline_registry();
+
+	pipeline_registry(const pipeline_registry &) = delete;
+	pipeline_registry operator=(const pipeline_registry &) = delete;
+
+	ref<shader_module> get_shader_module(device &device, VkShaderStageFlagBits stage, const char *path);
+	ref<shared_pipeline> get_graphics_pipeline(device &device, const pipeline_key &key,
+	                                           const graphics_pipeline_desc &desc);
+	ref<shared_pipeline> get_compute_pipeline(device &device, const pipeline_key &key,
+	                                          const VkComputePipelineCreateInfo &info);
+
+	/* Returns immediately, the pipeline has no handle until a worker thread has compiled it. */
+	ref<shared_pipeline> request_graphics_pipeline(device &device, const pipeline_key &key,
+	                                               const ref<graphics_pipeline_desc> &desc);
+
+	/* Fast-links the pipeline from its library parts, compiling the parts that are not cached. Requires
+	 * VK_EXT_graphics_pipeline_library and a vertex shader. */
+	ref<shared_pipeline> link_graphics_pipeline(device &device, const pipeline_key &key,
+	                                            const graphics_pipeline_library_keys &keys,
+	                                            const ref<graphics_pipeline_desc> &desc);
+
+	/* As link_graphics_pipeline, but returns immediately. The parts that are not cached and the link are done by
+	 * worker threads. */
+	ref<shared_pipeline> request_linked_graphics_pipeline(device &device, const pipeline_key &key,
+	                                                      const graphics_pipeline_library_keys &keys,
+	                                                      const ref<graphics_pipeline_desc> &desc);
+
+	/* Pipelines waiting for their requested VkPipeline, see pipeline::update. */
+	void add_pending(pipeline &pipeline);
+	void remove_pending(pipeline &pipeline);
+
+	/* Pipelines using a fast link, swapped to the optimized link once it is ready. */
+	void add_unoptimized(pipeline &pipeline);
+
+	/* Swaps the requested VkPipelines into all pending pipelines once every one of them has compiled, so that state
+	 * changed together becomes visible together. Returns false while compiles are in flight. Must be called at a
+	 * frame boundary, the previous VkPipelines may be destroyed. */
+	bool swap_pending();
+
+	void wait(const shared_pipeline &pipeline);
+	void wait_idle();
+
+	pipeline_registry_statistics m_statistics = {};
+	bool m_optimize_links = true;
+
+	/* Set by swap_pending if it changed the handle of any pipeline, commands recorded with the previous handles must
+	 * be recorded again. */
+	bool m_handles_swapped = false;
+
+private:
+	/* Compiles one library part of the description if m_part is set, otherwise links the libraries if there are any
+	 * or compiles the whole description. Links wait for their libraries, which are always submitted first. */
+	struct compile_job
+	{
+		ref<shared_pipeline> m_pipeline;
+		ref<graphics_pipeline_desc> m_desc;
+		std::vector<ref<shared_pipeline>> m_libraries;
+		VkGraphicsPipelineLibraryFlagsEXT m_part;
+		VkPipelineCreateFlags m_flags;
+		VkPipelineCache m_cache;
+	};
+
+	/* Pipelines by the hash of their key, a bucket holds all live pipelines whose keys share a hash. */
+	using pipeline_map = std::unordered_map<u64, std::vector<std::weak_ptr<shared_pipeline>>>;
+
+	static ref<shared_pipeline> find(pipeline_map &map, const pipeline_key &key);
+	static void insert(pipeline_map &map, const ref<shared_pipeline> &pipeline);
+
+	/* Parts that are not cached are compiled right away, or submitted to the workers if async is set. */
+	ref<shared_pipeline> get_library(device &device, pipeline_key key, VkGraphicsPipelineLibraryFlagsEXT part,
+	                                 const ref<graphics_pipeline_desc> &desc, bool async);
+	std::vector<ref<shared_pipeline>> get_libraries(device &device, const graphics_pipeline_library_keys &keys,
+	                                                const ref<graphics_pipeline_desc> &desc, bool async);
+	void submit_optimized_link(device &device, shared_pipeline &pipeline, const ref<graphics_pipeline_desc> &desc);
+	void submit(compile_job &&job);
+	void work();
+
+	std::unordered_map<u64, std::weak_ptr<shader_module>> m_shader_modules = {};
+	pipeline_map m_pipelines = {};
+	pipeline_map m_libraries = {};
+	std::vector<pipeline *> m_pending = {};
+	std::vector<pipeline *> m_unoptimized = {};
+
+	std::vector<std::thread> m_workers = {};
+	std::mutex m_mutex = {};
+	std::condition_variable m_job_condition = {};
+	std::condition_variable m_done_condition = {};
+	std::deque<compile_job> m_jobs = {};
+	u32 m_active_jobs = 0;
+	bool m_stop = false;
+};
+
+} /* namespace vulkan */
@@ -0,0 +1,83 @@
+#include "query_pool.h"
+#include "util.h"
+
+namespace vulkan
+{
+
+timestamp_query_pool::~timestamp_query_pool()
+{
+	if (m_handle != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(m_device_handle, m_handle, nullptr);
+	}
+}
+
+void timestamp_query_pool::build(device &device, u32 count)
+{
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(device.m_physical.m_handle, &device_properties);
+	m_supported = device_properties.limits.timestampComputeAndGraphics;
+	m_period = device_properties.limits.timestampPeriod;
+	if (!m_supported)
+	{
+		return;
+	}
+
+	const VkQueryPoolCreateInfo query_pool_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, //
+		.pNext = nullptr,                                  //
+		.flags = 0,                                        //
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,              //
+		.queryCount = count,                               //
+		.pipelineStatistics = 0,                           //
+	};
+	VULKAN_ASSERT_SUCCESS(vkCreateQueryPool(device.m_logical.m_handle, &query_pool_info, nullptr, &m_handle));
+
+	m_device_handle = device.m_logical.m_handle;
+	m_count = count;
+	m_written = false;
+	m_results.assign(2 * count, 0);
+}
+
+void timestamp_query_pool::reset(command_buffer &command_buffer)
+{
+	if (m_supported)
+	{
+		vkCmdResetQueryPool(command_buffer.m_handle, m_handle, 0, m_count);
+		m_written = true;
+	}
+}
+
+void timestamp_query_pool::write(command_buffer &command_buffer, u32 query, VkPipelineStageFlags2 stage)
+{
+	if (m_supported)
+	{
+		vkCmdWriteTimestamp2(command_buffer.m_handle, stage, m_handle, query);
+	}
+}
+
+bool timestamp_query_pool::read()
+{
+	if (!m_supported || !m_written)
+	{
+		return false;
+	}
+
+	/* Queries skipped this frame stay unavailable, so a partial result is not an error. */
+	const VkResult result =
+	    vkGetQueryPoolResults(m_device_handle, m_handle, 0, m_count, m_results.size() * sizeof(u64), m_results.data(),
+	                          2 * sizeof(u64), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	assert_if(VK_SUCCESS != result && VK_NOT_READY != result, "Failed to read timestamp queries");
+	return VK_SUCCESS == result;
+}
+
+float timestamp_query_pool::get_elapsed_ms(u32 begin, u32 end) const
+{
+	if (0 == m_results[2 * begin + 1] || 0 == m_results[2 * end + 1])
+	{
+		return 0.0f;
+	}
+	return (float)(m_results[2 * end] - m_results[2 * begin]) * m_period / 1000000.0f;
+}
+
+} /* namespace vulkan */
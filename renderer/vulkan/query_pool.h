@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include <third_party/volk/volk.h>
+#pragma clang diagnostic pop
+
+#include <utils/type.h>
+
+#include "command_buffer.h"
+#include "device.h"
+
+namespace vulkan
+{
+
+/* GPU timestamps written during a frame and read back once the frame has finished. */
+class timestamp_query_pool
+{
+public:
+	timestamp_query_pool() = default;
+	~timestamp_query_pool();
+
+	timestamp_query_pool(const timestamp_query_pool &) = delete;
+	timestamp_query_pool operator=(const timestamp_query_pool &) = delete;
+
+	void build(device &device, u32 count);
+
+	/* Must be recorded outside of rendering, before any write. */
+	void reset(command_buffer &command_buffer);
+	void write(command_buffer &command_buffer, u32 query, VkPipelineStageFlags2 stage);
+
+	/* Returns false if nothing has been written or results are not available yet. */
+	bool read();
+
+	/* Milliseconds between two queries, valid after a successful read. */
+	float get_elapsed_ms(u32 begin, u32 end) const;
+
+	VkQueryPool m_handle = {};
+	bool m_supported = false;
+
+private:
+	VkDevice m_device_handle = {};
+	u32 m_count = 0;
+	float m_period = 0.0f; /* Nanoseconds per tick. */
+	bool m_written = false;
+	std::vector<u64> m_results = {}; /* Value and availability per query. */
+};
+
+} /* namespace vulkan */
@@ -1,10 +1,13 @@
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
 
 #include <third_party/SPIRV-Cross/spirv_cross.hpp>
 #include <third_party/SPIRV-Cross/spirv_glsl.hpp>
 
+#include <platform/file.h>
+#include <utils/log.h>
 #include <utils/util.h>
 
 #include "shader.h"
@@ -23,28 +26,147 @@ shader_module::~shader_module()
 
 static VkFormat spirv_type_to_vkformat(const spirv_cross ::SPIRType &type)
 {
-	if (type.basetype == spirv_cross::SPIRType::Float && type.columns == 1)
+	if (type.columns != 1 || type.vecsize < 1 || type.vecsize > 4)
 	{
-		switch (type.vecsize)
-		{
-		case 1:
-			return VK_FORMAT_R32_SFLOAT;
-		case 2:
-			return VK_FORMAT_R32G32_SFLOAT;
-		case 3:
-			return VK_FORMAT_R32G32B32_SFLOAT;
-		case 4:
-			return VK_FORMAT_R32G32B32A32_SFLOAT;
-		}
+		assert_if(true, "spirv_type_to_vkformat found unsupported spirv_cross::SPIRType");
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	switch (type.basetype)
+	{
+	case spirv_cross::SPIRType::Float:
+	{
+		constexpr VkFormat formats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT,
+			                             VK_FORMAT_R32G32B32A32_SFLOAT };
+		return formats[type.vecsize - 1];
+	}
+	case spirv_cross::SPIRType::Half:
+	{
+		constexpr VkFormat formats[] = { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT,
+			                             VK_FORMAT_R16G16B16A16_SFLOAT };
+		return formats[type.vecsize - 1];
+	}
+	case spirv_cross::SPIRType::Int:
+	{
+		constexpr VkFormat formats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+			                             VK_FORMAT_R32G32B32A32_SINT };
+		return formats[type.vecsize - 1];
+	}
+	case spirv_cross::SPIRType::UInt:
+	{
+		constexpr VkFormat formats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+			                             VK_FORMAT_R32G32B32A32_UINT };
+		return formats[type.vecsize - 1];
+	}
+	default:
+		break;
 	}
 
 	assert_if(true, "spirv_type_to_vkformat found unsupported spirv_cross::SPIRType");
 	return VK_FORMAT_UNDEFINED;
 }
 
-void shader_module::reflect(std::vector<u32> &binary)
+u32 get_vertex_format_size(VkFormat format)
 {
-	spirv_cross::Compiler compiler(binary);
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SNORM:
+	case VK_FORMAT_R8G8B8A8_UINT:
+	case VK_FORMAT_R8G8B8A8_SINT:
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+	case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+	case VK_FORMAT_R16G16_UNORM:
+	case VK_FORMAT_R16G16_SNORM:
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_R32_SFLOAT:
+	case VK_FORMAT_R32_SINT:
+	case VK_FORMAT_R32_UINT:
+		return 4;
+	case VK_FORMAT_R16_SFLOAT:
+		return 2;
+	case VK_FORMAT_R16G16B16_SFLOAT:
+		return 6;
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R16G16B16A16_SNORM:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_R32G32_SINT:
+	case VK_FORMAT_R32G32_UINT:
+		return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT:
+	case VK_FORMAT_R32G32B32_SINT:
+	case VK_FORMAT_R32G32B32_UINT:
+		return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+	case VK_FORMAT_R32G32B32A32_SINT:
+	case VK_FORMAT_R32G32B32A32_UINT:
+		return 16;
+	default:
+		break;
+	}
+
+	assert_if(true, "get_vertex_format_size found unsupported VkFormat %u", format);
+	return 0;
+}
+
+/* Integer inputs must be fed by integer formats of the same signedness, everything else is read as float. */
+static u32 get_vertex_format_class(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UINT:
+	case VK_FORMAT_R32_UINT:
+	case VK_FORMAT_R32G32_UINT:
+	case VK_FORMAT_R32G32B32_UINT:
+	case VK_FORMAT_R32G32B32A32_UINT:
+		return 1;
+	case VK_FORMAT_R8G8B8A8_SINT:
+	case VK_FORMAT_R32_SINT:
+	case VK_FORMAT_R32G32_SINT:
+	case VK_FORMAT_R32G32B32_SINT:
+	case VK_FORMAT_R32G32B32A32_SINT:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+bool is_vertex_format_compatible(VkFormat reflected_format, VkFormat format)
+{
+	return get_vertex_format_class(reflected_format) == get_vertex_format_class(format);
+}
+
+u64 hash_shader_code(std::span<const u32> code)
+{
+	u64 hash = 0;
+	for (u32 word : code)
+	{
+		hash = hash_combine(hash, word);
+	}
+	return hash;
+}
+
+/* Header of the reflection cache, followed by the attribute descriptions and resource bindings. */
+struct shader_reflection_file_header
+{
+	u32 magic;
+	u32 version;
+	u64 code_hash;
+	u32 stage;
+	u32 vad_count;
+	u32 resource_binding_count;
+	u32 specialization_constant_count;
+	u32 push_constants_size;
+	VkVertexInputBindingDescription vbd;
+};
+
+static constexpr u32 shader_reflection_magic = 0x4c464552; /* "REFL". */
+static constexpr u32 shader_reflection_version = 2; /* Bumped whenever reflect() changes. */
+
+void shader_module::reflect(std::span<const u32> code)
+{
+	spirv_cross::Compiler compiler(code.data(), code.size());
 	const auto &resources = compiler.get_shader_resources();
 
 	/* Attributes. */
@@ -70,7 +192,7 @@ void shader_module::reflect(std::vector<u32> &binary)
 			attr.format = spirv_type_to_vkformat(type);
 			attr.offset = stride;
 			m_vads.push_back(attr);
-			stride += type.vecsize * sizeof(float);
+			stride += get_vertex_format_size(attr.format);
 		}
 
 		m_vbd.binding = default_binding;
@@ -79,13 +201,27 @@ void shader_module::reflect(std::vector<u32> &binary)
 	}
 
 	/* Descriptor sets. */
+	const auto get_set = [&](spirv_cross::ID id, bool bindless)
+	{
+		const u32 set = compiler.get_decoration(id, spv::DecorationDescriptorSet);
+		assert_if(set >= descriptor_set_count, "Descriptor set index %u out of range", set);
+		assert_if(!bindless && bindless_table::set_index == set, "Only sampled textures live in the bindless set");
+		return set;
+	};
 	for (const auto &image : resources.sampled_images)
 	{
-		assert_if(compiler.get_decoration(image.id, spv::DecorationDescriptorSet) != 0,
-		          "Only single descriptor set at index 0 supported");
-
-		const u32 set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
+		const u32 set = get_set(image.id, /* bindless = */ true);
 		const u32 binding = compiler.get_decoration(image.id, spv::DecorationBinding);
+		if (bindless_table::set_index == set)
+		{
+			/* Must match the arrays of bindless_table. */
+			const spirv_cross::SPIRType &type = compiler.get_type(image.type_id);
+			const spv::Dim dim = bindless_table::texture_cube_binding == binding ? spv::DimCube : spv::Dim2D;
+			assert_if(type.array.size() != 1 || type.array[0] != 0, "Bindless textures must be runtime arrays");
+			assert_if(binding != bindless_table::texture_2d_binding && binding != bindless_table::texture_cube_binding,
+			          "Unknown bindless texture binding %u", binding);
+			assert_if(type.image.dim != dim, "Bindless texture binding %u has the wrong image type", binding);
+		}
 		m_resource_bindings.push_back({ set, binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER });
 	}
 	for (const auto &image : resources.subpass_inputs)
@@ -95,32 +231,34 @@ void shader_module::reflect(std::vector<u32> &binary)
 	}
 	for (const auto &image : resources.separate_images)
 	{
-		UNUSED(image);
-		assert_if(true, "No support for separate image descriptors");
+		const u32 set = get_set(image.id, /* bindless = */ false);
+		const u32 binding = compiler.get_decoration(image.id, spv::DecorationBinding);
+		assert_if(compiler.get_type(image.type_id).image.dim == spv::DimBuffer, "No support for texel buffers");
+		m_resource_bindings.push_back({ set, binding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE });
 	}
 	for (const auto &sampler : resources.separate_samplers)
 	{
-		UNUSED(sampler);
-		assert_if(true, "No support for separate sampler descriptors");
+		const u32 set = get_set(sampler.id, /* bindless = */ false);
+		const u32 binding = compiler.get_decoration(sampler.id, spv::DecorationBinding);
+		m_resource_bindings.push_back({ set, binding, VK_DESCRIPTOR_TYPE_SAMPLER });
 	}
 	for (const auto &image : resources.storage_images)
 	{
-		UNUSED(image);
-		assert_if(true, "No support for storage image descriptors");
+		const u32 set = get_set(image.id, /* bindless = */ false);
+		const u32 binding = compiler.get_decoration(image.id, spv::DecorationBinding);
+		m_resource_bindings.push_back({ set, binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE });
 	}
 	for (const auto &buffer : resources.uniform_buffers)
 	{
-		assert_if(compiler.get_decoration(buffer.id, spv::DecorationDescriptorSet) != 0,
-		          "Only single descriptor set at index 0 supported");
-
-		const u32 set = compiler.get_decoration(buffer.id, spv::DecorationDescriptorSet);
+		const u32 set = get_set(buffer.id, /* bindless = */ false);
 		const u32 binding = compiler.get_decoration(buffer.id, spv::DecorationBinding);
 		m_resource_bindings.push_back({ set, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER });
 	}
 	for (const auto &buffer : resources.storage_buffers)
 	{
-		UNUSED(buffer);
-		assert_if(true, "No support for storage buffer descriptors");
+		const u32 set = get_set(buffer.id, /* bindless = */ false);
+		const u32 binding = compiler.get_decoration(buffer.id, spv::DecorationBinding);
+		m_resource_bindings.push_back({ set, binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER });
 	}
 
 	/* Push constants. */
@@ -130,40 +268,136 @@ void shader_module::reflect(std::vector<u32> &binary)
 		    compiler.get_declared_struct_size(compiler.get_type(resources.push_constant_buffers.front().base_type_id));
 	}
 
-	/* Specialization constants. */
-	auto spec_constants = compiler.get_specialization_constants();
-	for (const auto &constants : spec_constants)
+	/* Specialization constants, booleans are VkBool32 so that all constants take 4 bytes. */
+	for (const spirv_cross::SpecializationConstant &constant : compiler.get_specialization_constants())
 	{
-		UNUSED(constants);
-		assert_if(true, "No support for specialization constants");
+		const spirv_cross::SPIRType &type = compiler.get_type(compiler.get_constant(constant.id).constant_type);
+		assert_if(type.vecsize != 1 || type.columns != 1 ||
+		              (type.basetype != spirv_cross::SPIRType::Boolean && type.width != 32),
+		          "Only 32-bit scalar and boolean specialization constants supported");
+		m_specialization_constant_ids.push_back(constant.constant_id);
 	}
 }
 
-void shader_module::build(device &device, VkShaderStageFlagBits stage, const char *filename)
+bool shader_module::load_reflection(const std::string &path)
 {
-	m_device = &device;
+	mapped_file file = {};
+	shader_reflection_file_header header = {};
+	if (!file.build(path.c_str()) || file.m_size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, file.m_data, sizeof(header));
+	if (header.magic != shader_reflection_magic || header.version != shader_reflection_version ||
+	    header.code_hash != m_hash || header.stage != (u32)m_stage ||
+	    file.m_size != sizeof(header) + header.vad_count * sizeof(VkVertexInputAttributeDescription) +
+	                       header.resource_binding_count * sizeof(shader_resource_binding) +
+	                       header.specialization_constant_count * sizeof(u32))
+	{
+		return false;
+	}
 
-	m_stage = stage;
-	std::string shader_code = {};
+	const u8 *data = file.m_data + sizeof(header);
+	m_vads.resize(header.vad_count);
+	memcpy(m_vads.data(), data, m_vads.size() * sizeof(VkVertexInputAttributeDescription));
+	data += m_vads.size() * sizeof(VkVertexInputAttributeDescription);
+	m_resource_bindings.resize(header.resource_binding_count);
+	memcpy(m_resource_bindings.data(), data, m_resource_bindings.size() * sizeof(shader_resource_binding));
+	data += m_resource_bindings.size() * sizeof(shader_resource_binding);
+	m_specialization_constant_ids.resize(header.specialization_constant_count);
+	memcpy(m_specialization_constant_ids.data(), data, m_specialization_constant_ids.size() * sizeof(u32));
+	m_vbd = header.vbd;
+	m_push_constants_size = header.push_constants_size;
+	return true;
+}
+
+void shader_module::save_reflection(const std::string &path) const
+{
+	shader_reflection_file_header header = {};
+	header.magic = shader_reflection_magic;
+	header.version = shader_reflection_version;
+	header.code_hash = m_hash;
+	header.stage = m_stage;
+	header.vad_count = m_vads.size();
+	header.resource_binding_count = m_resource_bindings.size();
+	header.specialization_constant_count = m_specialization_constant_ids.size();
+	header.push_constants_size = m_push_constants_size;
+	header.vbd = m_vbd;
+
+	/* Written next to the cache and renamed over it, as the pipeline cache. The cache is only an optimization. */
+	const std::string temporary_path = path + ".tmp";
 	{
-		std::ifstream file(filename, std::ios::binary);
-		assert_if(!file.is_open(), "Could not open shader %s", filename);
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char *>(m_vads.data()),
+		           m_vads.size() * sizeof(VkVertexInputAttributeDescription));
+		file.write(reinterpret_cast<const char *>(m_resource_bindings.data()),
+		           m_resource_bindings.size() * sizeof(shader_resource_binding));
+		file.write(reinterpret_cast<const char *>(m_specialization_constant_ids.data()),
+		           m_specialization_constant_ids.size() * sizeof(u32));
+		file.flush();
+		if (!file.good())
+		{
+			logger::warn("Could not write shader reflection %s", temporary_path.c_str());
+			return;
+		}
+	}
 
-		std::stringstream file_data = {};
-		file_data << file.rdbuf();
-		shader_code = file_data.str();
+	std::error_code error = {};
+	std::filesystem::rename(temporary_path, path, error);
+	if (error)
+	{
+		logger::warn("Could not replace shader reflection %s: %s", path.c_str(), error.message().c_str());
+		std::filesystem::remove(temporary_path, error);
 	}
+}
+
+void shader_module::build(device &device, VkShaderStageFlagBits stage, const char *filename,
+                          std::span<const u32> code, u64 hash)
+{
+	m_device = &device;
+
+	m_stage = stage;
+	m_filename = filename;
+	m_hash = hash;
 
 	/* Get attributes, descriptors, push constants. */
-	const u32 *shader_code_ptr = reinterpret_cast<const u32 *>(shader_code.data());
-	std::vector<u32> shader_code_vector(shader_code_ptr, shader_code_ptr + shader_code.size() / sizeof(u32));
-	reflect(shader_code_vector);
+	const std::string reflection_path = m_filename + ".reflect";
+	if (!load_reflection(reflection_path))
+	{
+		reflect(code);
+		save_reflection(reflection_path);
+	}
 
-	/* Finalize Vulkan module. */
+	build_module(code);
+}
+
+void shader_module::build(device &device, const embedded_shader &shader)
+{
+	m_device = &device;
+
+	m_stage = shader.m_stage;
+	m_filename = shader.m_path;
+	m_hash = shader.m_hash;
+	m_embedded_code = shader.m_code;
+
+	/* Reflected when the shader was embedded. */
+	m_vbd = shader.m_vbd;
+	m_vads.assign(shader.m_vads.begin(), shader.m_vads.end());
+	m_resource_bindings.assign(shader.m_resource_bindings.begin(), shader.m_resource_bindings.end());
+	m_specialization_constant_ids.assign(shader.m_specialization_constant_ids.begin(),
+	                                     shader.m_specialization_constant_ids.end());
+	m_push_constants_size = shader.m_push_constants_size;
+
+	build_module(shader.m_code);
+}
+
+void shader_module::build_module(std::span<const u32> code)
+{
 	VkShaderModuleCreateInfo create_info = {};
 	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	create_info.codeSize = shader_code.size();
-	create_info.pCode = reinterpret_cast<const uint32_t *>(shader_code.c_str());
+	create_info.codeSize = code.size_bytes();
+	create_info.pCode = code.data();
 
 	VULKAN_ASSERT_SUCCESS(vkCreateShaderModule(m_device->m_logical.m_handle, &create_info, nullptr, &m_handle));
 }
@@ -188,10 +422,11 @@ shader_object::~shader_object()
 
 static VkShaderStageFlags get_next_stage(VkShaderStageFlagBits stage)
 {
+	/* Tessellation and geometry shaders are not enabled, vertex shaders always feed fragment shaders. */
 	switch (stage)
 	{
 	case VK_SHADER_STAGE_VERTEX_BIT:
-		return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		return VK_SHADER_STAGE_FRAGMENT_BIT;
 	case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
 		return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_GEOMETRY_BIT |
 		       VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -210,35 +445,39 @@ static VkShaderStageFlags get_next_stage(VkShaderStageFlagBits stage)
 	return VK_SHADER_STAGE_VERTEX_BIT;
 }
 
-void shader_object::build(device &device, VkShaderStageFlagBits stage, const char *filename)
+void shader_object::build(device &device, const shader_module &shader,
+                          const std::vector<VkDescriptorSetLayout> &set_layouts,
+                          const VkPushConstantRange *push_constants, const VkSpecializationInfo *specialization_info)
 {
-	/* Read SPIR-V from filename. */
-	std::string shader_code = {};
-	std::ifstream file(filename, std::ios::binary);
-	assert_if(!file.is_open(), "Could not open shader %s", filename);
-	std::stringstream file_data = {};
-	file_data << file.rdbuf();
-	shader_code = file_data.str();
+	/* Map SPIR-V from filename, unless it was embedded. */
+	mapped_file file = {};
+	std::span<const u32> code = shader.m_embedded_code;
+	if (code.empty())
+	{
+		assert_if(!file.build(shader.m_filename.c_str()), "Could not open shader %s", shader.m_filename.c_str());
+		code = std::span<const u32>(reinterpret_cast<const u32 *>(file.m_data), file.m_size / sizeof(u32));
+	}
 
 	/* Initialize Vulkan shader object. */
 	VkShaderCreateInfoEXT info = {
-		.sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT, //
-		.pNext = nullptr,                                  //
-		.flags = 0,                                        //
-		.stage = stage,                                    //
-		.nextStage = get_next_stage(stage),                //
-		.codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT,         //
-		.codeSize = shader_code.size(),                    //
-		.pCode = shader_code.c_str(),                      //
-		.pName = "main",                                   //
-		.setLayoutCount = 0,                               //
-		.pSetLayouts = nullptr,                            //
-		.pushConstantRangeCount = 0,                       //
-		.pPushConstantRanges = nullptr,                    //
-		.pSpecializationInfo = nullptr,                    //
+		.sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,  //
+		.pNext = nullptr,                                   //
+		.flags = 0,                                         //
+		.stage = shader.m_stage,                            //
+		.nextStage = get_next_stage(shader.m_stage),        //
+		.codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT,          //
+		.codeSize = code.size_bytes(),                      //
+		.pCode = code.data(),                               //
+		.pName = "main",                                    //
+		.setLayoutCount = (u32)set_layouts.size(),          //
+		.pSetLayouts = set_layouts.data(),                  //
+		.pushConstantRangeCount = push_constants ? 1u : 0u, //
+		.pPushConstantRanges = push_constants,              //
+		.pSpecializationInfo = specialization_info,         //
 	};
 	VULKAN_ASSERT_SUCCESS(vkCreateShadersEXT(device.m_logical.m_handle, 1, &info, nullptr, &m_handle));
 
+	m_stage = shader.m_stage;
 	m_device_handle = device.m_logical.m_handle;
 }
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <span>
+#include <string>
+#include <vector>
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Weverything"
 #include <third_party/volk/volk.h>
@@ -18,6 +22,30 @@ struct shader_resource_binding
 	VkDescriptorType type;
 };
 
+/* Reflection yields 32-bit attributes, pipelines may override them with packed formats. */
+u32 get_vertex_format_size(VkFormat format);
+bool is_vertex_format_compatible(VkFormat reflected_format, VkFormat format);
+
+/* Content hash of SPIR-V code, modules with equal hashes are interchangeable. */
+u64 hash_shader_code(std::span<const u32> code);
+
+/* SPIR-V and reflection compiled into the editor by tools/embed_shaders.cpp, looked up by the path it was built to. */
+struct embedded_shader
+{
+	const char *m_path;
+	VkShaderStageFlagBits m_stage;
+	std::span<const u32> m_code;
+	u64 m_hash;
+	VkVertexInputBindingDescription m_vbd;
+	std::span<const VkVertexInputAttributeDescription> m_vads;
+	std::span<const shader_resource_binding> m_resource_bindings;
+	u32 m_push_constants_size;
+	std::span<const u32> m_specialization_constant_ids;
+};
+
+/* Defined in the generated embedded_shaders.cpp, returns nullptr for shaders that were not embedded. */
+const embedded_shader *find_embedded_shader(const char *path);
+
 class shader_module
 {
 public:
@@ -27,19 +55,31 @@ public:
 	shader_module(const shader_module &) = delete;
 	shader_module operator=(const shader_module &) = delete;
 
-	void build(device &device, VkShaderStageFlagBits stage, const char *filename);
+	/* Code is the SPIR-V of filename and hash its hash_shader_code. Reflection is read from a cache next to the file
+	 * if it was written for the same code, and reflected and written there otherwise. */
+	void build(device &device, VkShaderStageFlagBits stage, const char *filename, std::span<const u32> code, u64 hash);
+	void build(device &device, const embedded_shader &shader);
 	VkPipelineShaderStageCreateInfo get_pipeline_shader_stage_create_info() const;
 
+	/* Fills the reflected members below from code and m_stage, without a device. */
+	void reflect(std::span<const u32> code);
+
 	VkShaderModule m_handle = {};
 	VkShaderStageFlagBits m_stage = {};
+	std::string m_filename = {};
+	u64 m_hash = 0;                            /* Of the SPIR-V code. */
+	std::span<const u32> m_embedded_code = {}; /* Embedded shaders have no file. */
 
 	VkVertexInputBindingDescription m_vbd = {};
 	std::vector<VkVertexInputAttributeDescription> m_vads = {};
 	std::vector<shader_resource_binding> m_resource_bindings = {};
 	u32 m_push_constants_size = 0;
+	std::vector<u32> m_specialization_constant_ids = {};
 
 private:
-	void reflect(std::vector<u32> &binary);
+	void build_module(std::span<const u32> code);
+	bool load_reflection(const std::string &path);
+	void save_reflection(const std::string &path) const;
 
 	device *m_device = nullptr;
 };
@@ -53,9 +93,12 @@ public:
 	shader_object(const shader_object &) = delete;
 	shader_object operator=(const shader_object &) = delete;
 
-	void build(device &device, VkShaderStageFlagBits stage, const char *filename);
+	/* Set layouts and push constants must match the pipeline layout descriptors are pushed with. */
+	void build(device &device, const shader_module &shader, const std::vector<VkDescriptorSetLayout> &set_layouts,
+	           const VkPushConstantRange *push_constants, const VkSpecializationInfo *specialization_info);
 
-	VkShaderEXT m_handle;
+	VkShaderEXT m_handle = {};
+	VkShaderStageFlagBits m_stage = {};
 
 private:
 	VkDevice m_device_handle = {};
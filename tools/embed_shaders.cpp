@@ -0,0 +1,191 @@
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <platform/file.h>
+#include <renderer/vulkan/shader.h>
+#include <utils/util.h>
+
+/* Build step of the editor. Writes SPIR-V and its reflection as constexpr tables, together with the
+ * find_embedded_shader that looks them up, so that shader modules need no file access or reflection at runtime.
+ *
+ * Usage: embed_shaders <output.cpp> [<shader.spv> <path the editor requests it by>]... */
+
+static bool ends_with(const std::string &str, const char *suffix)
+{
+	const size_t length = strlen(suffix);
+	return str.size() >= length && 0 == str.compare(str.size() - length, length, suffix);
+}
+
+static VkShaderStageFlagBits get_stage_from_path(const std::string &path)
+{
+	if (ends_with(path, ".vert.spv"))
+	{
+		return VK_SHADER_STAGE_VERTEX_BIT;
+	}
+	else if (ends_with(path, ".frag.spv"))
+	{
+		return VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+	else if (ends_with(path, ".comp.spv"))
+	{
+		return VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	else if (ends_with(path, ".task.spv"))
+	{
+		return VK_SHADER_STAGE_TASK_BIT_EXT;
+	}
+	else if (ends_with(path, ".mesh.spv"))
+	{
+		return VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
+
+	assert_if(true, "Unknown shader stage of %s", path.c_str());
+	return VK_SHADER_STAGE_ALL;
+}
+
+static void write_shader_tables(FILE *out, u32 index, const vulkan::shader_module &shader, std::span<const u32> code)
+{
+	fprintf(out, "static constexpr u32 shader_%u_code[] = {", index);
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		fprintf(out, "%s0x%08x,", 0 == i % 8 ? "\n\t" : " ", code[i]);
+	}
+	fprintf(out, "\n};\n");
+
+	/* Arrays cannot be empty, empty tables are left out and become empty spans. */
+	if (!shader.m_vads.empty())
+	{
+		fprintf(out, "static constexpr VkVertexInputAttributeDescription shader_%u_vads[] = {\n", index);
+		for (const VkVertexInputAttributeDescription &vad : shader.m_vads)
+		{
+			fprintf(out, "\t{ %u, %u, (VkFormat)%u, %u },\n", vad.location, vad.binding, vad.format, vad.offset);
+		}
+		fprintf(out, "};\n");
+	}
+	if (!shader.m_resource_bindings.empty())
+	{
+		fprintf(out, "static constexpr shader_resource_binding shader_%u_resource_bindings[] = {\n", index);
+		for (const shader_resource_binding &binding : shader.m_resource_bindings)
+		{
+			fprintf(out, "\t{ %u, %u, (VkDescriptorType)%u },\n", binding.set, binding.binding, binding.type);
+		}
+		fprintf(out, "};\n");
+	}
+	if (!shader.m_specialization_constant_ids.empty())
+	{
+		fprintf(out, "static constexpr u32 shader_%u_specialization_constant_ids[] = {", index);
+		for (u32 id : shader.m_specialization_constant_ids)
+		{
+			fprintf(out, " %u,", id);
+		}
+		fprintf(out, " };\n");
+	}
+	fprintf(out, "\n");
+}
+
+static void write_shader_entry(FILE *out, u32 index, const char *path, const vulkan::shader_module &shader)
+{
+	fprintf(out, "\t{\n");
+	fprintf(out, "\t    .m_path = \"%s\",\n", path);
+	fprintf(out, "\t    .m_stage = (VkShaderStageFlagBits)%u,\n", shader.m_stage);
+	fprintf(out, "\t    .m_code = shader_%u_code,\n", index);
+	fprintf(out, "\t    .m_hash = 0x%016llxull,\n", (unsigned long long)shader.m_hash);
+	fprintf(out, "\t    .m_vbd = { %u, %u, (VkVertexInputRate)%u },\n", shader.m_vbd.binding, shader.m_vbd.stride,
+	        shader.m_vbd.inputRate);
+	if (shader.m_vads.empty())
+	{
+		fprintf(out, "\t    .m_vads = {},\n");
+	}
+	else
+	{
+		fprintf(out, "\t    .m_vads = shader_%u_vads,\n", index);
+	}
+	if (shader.m_resource_bindings.empty())
+	{
+		fprintf(out, "\t    .m_resource_bindings = {},\n");
+	}
+	else
+	{
+		fprintf(out, "\t    .m_resource_bindings = shader_%u_resource_bindings,\n", index);
+	}
+	fprintf(out, "\t    .m_push_constants_size = %u,\n", shader.m_push_constants_size);
+	if (shader.m_specialization_constant_ids.empty())
+	{
+		fprintf(out, "\t    .m_specialization_constant_ids = {},\n");
+	}
+	else
+	{
+		fprintf(out, "\t    .m_specialization_constant_ids = shader_%u_specialization_constant_ids,\n", index);
+	}
+	fprintf(out, "\t},\n");
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || 0 != (argc - 2) % 2)
+	{
+		fprintf(stderr, "Usage: %s <output.cpp> [<shader.spv> <path>]...\n", argv[0]);
+		return 1;
+	}
+
+	/* Reflect everything first, so that a failure leaves no partial output behind. */
+	const u32 shader_count = (argc - 2) / 2;
+	std::vector<mapped_file> files(shader_count);
+	std::vector<vulkan::shader_module> shaders(shader_count);
+	for (u32 i = 0; i < shader_count; ++i)
+	{
+		const char *spv_path = argv[2 + i * 2];
+		if (!files[i].build(spv_path))
+		{
+			fprintf(stderr, "Could not open shader %s\n", spv_path);
+			return 1;
+		}
+		const std::span<const u32> code(reinterpret_cast<const u32 *>(files[i].m_data),
+		                                files[i].m_size / sizeof(u32));
+		shaders[i].m_stage = get_stage_from_path(argv[3 + i * 2]);
+		shaders[i].m_hash = hash_shader_code(code);
+		shaders[i].reflect(code);
+	}
+
+	FILE *out = fopen(argv[1], "w");
+	if (nullptr == out)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 1;
+	}
+
+	fprintf(out, "/* Generated by tools/embed_shaders.cpp, do not edit. */\n\n");
+	fprintf(out, "#include <array>\n#include <cstring>\n\n#include <renderer/vulkan/shader.h>\n\n");
+	fprintf(out, "namespace vulkan\n{\n\n");
+	for (u32 i = 0; i < shader_count; ++i)
+	{
+		const std::span<const u32> code(reinterpret_cast<const u32 *>(files[i].m_data),
+		                                files[i].m_size / sizeof(u32));
+		write_shader_tables(out, i, shaders[i], code);
+	}
+
+	fprintf(out, "static constexpr std::array<embedded_shader, %u> shaders = { {\n", shader_count);
+	for (u32 i = 0; i < shader_count; ++i)
+	{
+		write_shader_entry(out, i, argv[3 + i * 2], shaders[i]);
+	}
+	fprintf(out, "} };\n\n");
+
+	fprintf(out, "const embedded_shader *find_embedded_shader(const char *path)\n{\n");
+	fprintf(out, "\tfor (const embedded_shader &shader : shaders)\n\t{\n");
+	fprintf(out, "\t\tif (0 == strcmp(shader.m_path, path))\n\t\t{\n\t\t\treturn &shader;\n\t\t}\n\t}\n");
+	fprintf(out, "\treturn nullptr;\n}\n\n");
+	fprintf(out, "} /* namespace vulkan */\n");
+
+	const bool written = 0 == ferror(out);
+	fclose(out);
+	if (!written)
+	{
+		fprintf(stderr, "Could not write %s\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
@@ -31,3 +31,13 @@ float random_float()
 	static std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 	return dist(gen);
 }
+
+u64 hash_combine(u64 seed, u64 value)
+{
+	/* splitmix64 finalizer of the value, folded into the seed as in boost::hash_combine. */
+	value += 0x9e3779b97f4a7c15ull;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	value ^= value >> 31;
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "type.h"
+
 #define UNUSED(x) (void)x
 
 void assert_if(bool st, const char *e, ...);
 float random_float();
+
+/* Mixes value into seed, for keys built from several handles or state values. */
+u64 hash_combine(u64 seed, u64 value);